@@ -1,1414 +1,4977 @@
-/* This files provides address values that exist in the system */
-
-#define SDRAM_BASE            0xC0000000
-#define FPGA_ONCHIP_BASE      0xC8000000
-#define FPGA_CHAR_BASE        0xC9000000
-
-/* Cyclone V FPGA devices */
-#define LEDR_BASE             0xFF200000
-#define HEX3_HEX0_BASE        0xFF200020
-#define HEX5_HEX4_BASE        0xFF200030
-#define SW_BASE               0xFF200040
-#define KEY_BASE              0xFF200050
-#define TIMER_BASE            0xFF202000
-#define PIXEL_BUF_CTRL_BASE   0xFF203020
-#define CHAR_BUF_CTRL_BASE    0xFF203030
-#define PS2_BASE              0xFF200100
-
-
-/* VGA colors */
-#define WHITE 0xFFFF
-#define BLACK 0x0000
-#define YELLOW 0xFFE0
-#define RED 0xF800
-#define GREEN 0x07E0
-#define BLUE 0x001F
-#define CYAN 0x07FF
-#define MAGENTA 0xF81F
-#define GREY 0xC618
-#define PINK 0xFC18
-#define ORANGE 0xFC00
-#define BACKGROUND 0x0570
-#define GRADIENT 15
-#define DUNE_COLOR 0xFFB5
-#define NUM_BALL_COLORS 10
-	
-#define ABS(x) (((x) > 0) ? (x) : -(x))
-
-
-/* Screen size. */
-#define RESOLUTION_X 320
-#define RESOLUTION_Y 240
-
-// Ball location parameters
-#define BALL_X 20
-#define BALL_Y 10
-#define BALL_R 3
-#define MAX_SPEED 25
-#define MAX_ACCELERATION 3
-#define MIN_ACCELERATION 1
-
-//Dune parameters
-#define NUM_DUNES 15 //more than 3 plz
-#define MIDDLE_DUNE 180 //Highest point is 2/3 of Y, lowest point is 1/10 of Y, mid point is 23/60 of Y
-#define MAX_AMPLITUDE_DUNE 50 // from analysis, must be bigger than 10
-#define DUNE_FREQUENCY 3.1415926535897/80  // two dunes on the screen at all times
-#define DUNE_PERIOD 160 //half of the screen
-#define PI 3.1415926535897
-
-
-// arrow parameters
-#define ARROW_SCALE 0.3	// height per pixel out of bounds
-#define MIN_ARROW_HEIGHT 20
-#define MAX_ARROW_HEIGHT 60
-	
-// other PARAMETERS
-#define SCORE_LINE_Y 60
-#define X_2500 BALL_X + MAX_ARROW_HEIGHT/2
-#define Y_2500 SCORE_LINE_Y-15
-#define FRAMES_2500 12// must be greater than 2
-
-#include <stdlib.h>
-#include <stdio.h>
-#include <stdbool.h>
-#include <math.h>
-#include <time.h>
-
-// useful structs
-typedef struct Ball {
-	int x, y;
-	double dx, dy;
-	int color;
-	int radius;
-	// variables to help clear buffer
-	int x1, y1; // position 1 frame ago
-	int x2, y2; // position 2 frames ago
-} Ball;
-
-typedef struct Dune{
-	int dunePoints[RESOLUTION_X];
-	double duneAngles[RESOLUTION_X];
-	int dunePoints1[RESOLUTION_X];
-	int dunePoints2[RESOLUTION_X];
-} Dune;
-
-// note that this arrow will always be pointing upwards
-typedef struct Arrow {
-	int x, y; // location of arrow tip
-	int h; //current height
-	int h1; // 1 framge ago
-	int h2; // 2 frames ago
-	short int color;
-} Arrow;
-
-
-//functions we need to implement
-/*
-drawPixel();  // draws pixel at given location and color
-drawBackground(); // if possible
-drawDune(); // draws the dune on the screen
-drawBall();
-drawArrow();
-drawStartingScreen();
-drawScore(); //start the score on the screen
-drawGameOverScreen();
-gameOverCheck(); // check if the ball crashed or not
-inBounds function();
-updateGameInfo(); updates the position of the ball and the dunes before the next draw()
-clearScreen();
-wait_for_vsync();
-*/
-
-// helper functions
-bool in_bounds(int x, int y);
-bool in_y_bounds(int y);
-bool in_x_bounds(int x);
-void draw_line(int x0, int y0, int x1, int y1, short int line_color);
-bool isBallTouchingDune(Ball* ball, Dune* dune); 
-void display_score(int score);
-int max(int a, int b);
-int min(int a, int b);
-
-// drawing/buffer function
-void draw(Ball* ball, Dune* dune, Arrow* arrow, int score);
-void draw_ball(Ball* ball);
-void draw_dune(Dune* Dune);
-void draw_dune_slice(Dune* dune, int x1, int x2);
-void draw_arrow(Arrow* arrow);
-void update_arrow(Arrow* arrow, int y);
-void draw_starting_screen();
-void draw_game_over_screen(Ball* ball, Dune* dune, int points, int frames);
-void plot_pixel(int x, int y, short int line_color);
-void black_screen();
-void draw_background();
-void draw_score(int points);
-void draw_2500(int x, int y, short int color);
-
-// clearing functions
-void clear_pixel(int x, int y);
-void clear_line(int x0, int y0, int x1, int y1);
-void clear_rectangle(int x0, int y0, int x1, int y1);
-void clear_screen(Ball* ball, Dune* dune, Arrow* arrow);
-void clear_ball(Ball* ball);
-void clear_arrow(Arrow* arrow);
-void clear_running_dune(Dune* dune);
-void clear_all_dune(Dune* dune);
-
-void wait_for_vsync();
-
-// mouse functions
-void space_key_clicked(bool* flag);
-void receive_bytes(int n);
-// change color
-int read_SW();
-short int set_ball_color();
-
-volatile int pixel_buffer_start; // global variable
-unsigned char seven_seg_decode_table[] = {0x3F, 0x06, 0x5B, 0x4F, 0x66, 0x6D, 0x7D, 0x07, 0x7F, 0x67};
-short int ball_colors[] = {WHITE, RED, ORANGE, YELLOW, GREEN, CYAN, BLUE, MAGENTA, PINK, BLACK};
-// variables to clear +2500
-int toClear = 0;
-int toDraw = 0;
-
-int main(void){
-	//initialize location and game physics
-	Ball ball = {.x = BALL_X, .y = BALL_Y, .dx = 0, .dy = 0, .color = RED, .radius = BALL_R, 
-				 .x1 = BALL_X, .y1 = BALL_Y, .x2 = BALL_X, .y2 = BALL_Y};
-	Arrow arrow = {.x = BALL_X, .y = 5, .h = MIN_ARROW_HEIGHT, .h1 = MIN_ARROW_HEIGHT, .h2 = MIN_ARROW_HEIGHT, .color = WHITE};
-    double acceleration = 1;
-	
-	//parameters for the dunes
-	Dune dune;
-	// Dune lastDune; // commented to suppress error
-	double duneHeight[NUM_DUNES];
-	for(int i = 0; i < NUM_DUNES; i++){
-		// seeding rand for actual randomness
-		//srand(time(NULL));
-		duneHeight[i] = rand()%(MAX_AMPLITUDE_DUNE-10)+10; //between 10 and MAX_AMPLITUDE_DUNE
-	}
-	int allDunePoints[NUM_DUNES*DUNE_PERIOD];
-	double allDuneAngles[NUM_DUNES*DUNE_PERIOD];
-    int amplitude;
-	for(int x = 0; x < NUM_DUNES*DUNE_PERIOD; x++){
-		amplitude = (int) x/DUNE_PERIOD;
-		allDunePoints[x] = (int) duneHeight[amplitude]*sin(DUNE_FREQUENCY*(x%DUNE_PERIOD)) + MIDDLE_DUNE;
-		allDuneAngles[x] = atan(duneHeight[amplitude]*DUNE_FREQUENCY*cos(DUNE_FREQUENCY*(x%DUNE_PERIOD)));
-	}
-	double currentX = 0;
-
-	for(int x = 0; x < RESOLUTION_X; x++){
-		dune.dunePoints[x] = allDunePoints[x];
-		dune.duneAngles[x] = allDuneAngles[x];
-		dune.dunePoints1[x] = 239;
-		dune.dunePoints2[x] = 239;
-	}
-	
-	bool spacebar = false; // variable to store if spacebar is pressed	
-	
-	//game screen game
-	int startScreen = 1;
-	int gameOver = 0;
-	int gameOverFramesDrawn = 0;
-
-	// set up ps2 port
-	volatile int * PS2_ptr = (int *)PS2_BASE;
-	*(PS2_ptr) = 0xFF; // reset keyboard
-	receive_bytes(2); // receive acknowledge bits
-	
-	// variable for tracking time
-	//clock_t start;
-		
-	// set up buffers
-    volatile int * pixel_ctrl_ptr = (int *)0xFF203020;
-	
-	/* set front pixel buffer to start of FPGA On-chip memory */
-    *(pixel_ctrl_ptr + 1) = 0xC8000000; // first store the address in the back buffer
-    /* now, swap the front/back buffers, to set the front buffer location */
-    wait_for_vsync();
-    /* initialize a pointer to the pixel buffer, used by drawing functions */
-    pixel_buffer_start = *pixel_ctrl_ptr;
-	// clear the buffer at 0xc8000000 (back buffer)
-	draw_background();
-	
-    /* set back pixel buffer to start of SDRAM memory */
-    *(pixel_ctrl_ptr + 1) = 0xC0000000;
-	pixel_buffer_start = *(pixel_ctrl_ptr + 1); // we draw on the back buffer
-	// clear the back buffer
-	draw_background();
-	wait_for_vsync();
-	
-	// clear the score	
-	int score = 0;
-	while(1){		
-		/* Erase any game things that were drawn in the last iteration */
-		// set the buffer ID correctly and clear the screen
-		// clock_t start = clock();
-		if(!startScreen && !gameOver){
-			clear_screen(&ball, &dune, &arrow);
-			clear_running_dune(&dune);
-		}
-		
-		// printf("Clear screen: %.3fs\n", 1.0*(clock() - start) / CLOCKS_PER_SEC);
-		
-		// code for drawing the current game iteration
-		if(startScreen) draw_starting_screen();
-		// check for game over
-		else if(gameOver) {
-			ball.color = set_ball_color();
-			draw_game_over_screen(&ball, &dune, score, gameOverFramesDrawn);
-			gameOverFramesDrawn++;
-		}
-		else{
-			// check for ball color
-			ball.color = set_ball_color();
-			// check for +2500 score bonus
-			if (toDraw == FRAMES_2500)
-				score += 2500;
-			score = min(999999, score + ball.dx);
-			draw(&ball, &dune, &arrow, score);
-		}
-		
-		// printf("Draw: %.3fs\n", 1.0*(clock() - start) / CLOCKS_PER_SEC);
-		
-		display_score(score);
-		
-		//printf("Score %.3fs\n", 1.0*(clock() - start) / CLOCKS_PER_SEC);
-		space_key_clicked(&spacebar);
-		//printf("Spacebar: %.3fs\n", 1.0*(clock() - start) / CLOCKS_PER_SEC);
-		//update drawing
-		int prevY = ball.y;
-		double isGameOver = 0;
-		if(!startScreen && !gameOver){
-			if(spacebar) acceleration = MAX_ACCELERATION;
-			else acceleration = MIN_ACCELERATION;
-
-			
-			//update dune
-			currentX+= ball.dx;
-			if(currentX >= NUM_DUNES*DUNE_PERIOD) currentX -= NUM_DUNES*DUNE_PERIOD;
-        	for(int x = 0; x < RESOLUTION_X; x++){
-				int xINC = ((int)(x + currentX))%(NUM_DUNES*DUNE_PERIOD);
-				dune.dunePoints2[x] = dune.dunePoints1[x];
-				dune.dunePoints1[x] = dune.dunePoints[x];
-				dune.dunePoints[x] = allDunePoints[xINC];
-				dune.duneAngles[x] = allDuneAngles[xINC];
-			}
-			
-			//update ball position
-			ball.y += ball.dy + 0.5*acceleration;
-			
-			//update ball speeds
-			if(isBallTouchingDune(&ball,&dune)){
-				
-				for(int i = 0; i < ball.radius; i++){
-					if(ball.y+ball.radius > dune.dunePoints[ball.x+i]) ball.y = dune.dunePoints[ball.x+i]-ball.radius;
-					if(ball.y+ball.radius > dune.dunePoints[ball.x-i]) ball.y = dune.dunePoints[ball.x-i]-ball.radius;
-				}
-				double duneAngle = dune.duneAngles[ball.x];
-				double ballAngle = atan(ball.dy/ball.dx);
-				double speed = sqrt(ball.dx*ball.dx + ball.dy*ball.dy);
-				
-				if(ball.dx < 0 && duneAngle < 0 && acceleration == MIN_ACCELERATION) ;
-				else if(duneAngle > 0 && ballAngle >= 0){
-					double dx1 = speed*cos(ballAngle - duneAngle) + acceleration;
-
-					ball.dx = dx1*cos(duneAngle);
-					ball.dy = dx1*sin(duneAngle);
-				}
-				else if(duneAngle < 0 && ballAngle < 0){
-					duneAngle = - duneAngle;
-					ballAngle = - ballAngle;
-					
-					double dx1 = speed*cos(duneAngle - ballAngle) + acceleration;
-					
-					ball.dx = dx1*cos(duneAngle);
-					ball.dy = -dx1*sin(duneAngle);
-				}
-				else if(duneAngle < 0 && ballAngle >= 0){		
-					duneAngle = - duneAngle;
-					double dx1 = speed*cos(duneAngle + ballAngle) + acceleration;
-					if(ballAngle >= PI/2 - duneAngle && speed > MAX_SPEED) isGameOver = 1;
-					
-					ball.dx = dx1*cos(duneAngle);
-					ball.dy = -dx1*sin(duneAngle);
-				}
-				else if(duneAngle == 0){
-					ball.dy = (int) -(ball.dy + acceleration);
-					ball.dy += acceleration;
-					if(ball.dx < 1) ball.dx = acceleration;
-				}
-				else{
-       				ball.dy += acceleration;
-				}
-				
-				
-				//update ball speed to maximum
-				speed = min(MAX_SPEED, sqrt(ball.dx*ball.dx + ball.dy*ball.dy));
-				ballAngle = atan(ball.dy/ball.dx);
-				
-				ball.dy = speed*sin(ballAngle);
-				ball.dx = speed*cos(ballAngle);
-				
-				if(((int) ball.dx == 0) && duneAngle < 0) ball.dx = -1;
-			}
-    		else{
-       			ball.dy += 0.5*acceleration;
-    		}
-		}
-
-		// draw +2500
-		if (prevY > SCORE_LINE_Y && ball.y < SCORE_LINE_Y)
-			toDraw =  FRAMES_2500;
-		
-		//start the game after pressing space of the start screen
-		if(startScreen){
-			if(spacebar){
-				startScreen = 0;
-				draw_background();				
-				wait_for_vsync();
-				pixel_buffer_start = *(pixel_ctrl_ptr + 1);
-				draw_background();
-			}
-		}
-		else if(gameOver){ //reset values
-			if(spacebar && gameOverFramesDrawn >= 3){
-				gameOver = 0;
-				gameOverFramesDrawn = 0;
-				toDraw = 0; // set variables to clear +2500
-				toClear = 2; 
-				currentX = 0;
-				draw_background();
-				for(int x = 0; x < RESOLUTION_X; x++){
-					dune.dunePoints[x] = allDunePoints[x];
-					dune.duneAngles[x] = allDuneAngles[x];
-					dune.dunePoints1[x] = 239;
-					dune.dunePoints2[x] = 239;
-				}
-				wait_for_vsync();
-				pixel_buffer_start = *(pixel_ctrl_ptr + 1);
-				draw_background();
-				Ball newBall = {.x = BALL_X, .y = BALL_Y, .dx = 0, .dy = 0, .color = ball.color, .radius = BALL_R, 
-				 .x1 = BALL_X, .y1 = BALL_Y, .x2 = BALL_X, .y2 = BALL_Y};
-				ball = newBall;
-				for(int x = 0; x < RESOLUTION_X; x++){
-					dune.dunePoints[x] = allDunePoints[x];
-					dune.duneAngles[x] = allDuneAngles[x];
-					dune.dunePoints1[x] = 239;
-					dune.dunePoints2[x] = 239;
-				}
-				score = 0;
-			}
-		}
-		// printf("Update drawing: %.3fs\n", 1.0*(clock() - start) / CLOCKS_PER_SEC);
-		
-		if (score >= 999999)
-			gameOver = 1;
-		if(isGameOver) gameOver = 1;
-		
-		wait_for_vsync(); // swap front and back buffers on VGA vertical sync
-		pixel_buffer_start = *(pixel_ctrl_ptr + 1); // new back buffer
-		//printf("Total time: %.3fs\n", 1.0*(clock() - start) / CLOCKS_PER_SEC);
-		//printf("----------------------\n");
-	}
-}
-
-void wait_for_vsync(){
-    volatile int * pixel_ctrl_ptr = (int *)0xFF203020; //pointer to VGA controller
-    int status;
-    
-    *pixel_ctrl_ptr = 1; //write 1 in front buffer to launch the swap process
-    status = *(pixel_ctrl_ptr + 3); //poll the status bit of the status register, the other bit is A
-    while((status & 0x01)!=0){
-        status = *(pixel_ctrl_ptr + 3);
-    }
-    //after the swap, status bit will be 0
-}
-
-void black_screen(){
-	for(int x = 0; x < RESOLUTION_X; x++){
-		for(int y = 0; y < RESOLUTION_Y; y++){
-			plot_pixel(x,y,BLACK);
-		}
-	}
-}
-
-void draw_background(){
-	for(int x = 0; x < RESOLUTION_X; x++){
-		for(int y = 0; y < RESOLUTION_Y; y++){
-			clear_pixel(x, y);
-		}
-	}
-}
-
-void clear_screen(Ball* ball, Dune* dune, Arrow* arrow){
-	clear_rectangle(RESOLUTION_X-92, 5, RESOLUTION_X-4, 15);
-	
-	// clear ball and dunes
-	clear_ball(ball);
-	clear_arrow(arrow);
-	
-	// clear +2500
-	if (toClear > 0){
-		clear_rectangle(X_2500, Y_2500, X_2500+40, Y_2500+10);
-		toClear--;
-	}
-}
-
-void clear_rectangle(int x0, int y0, int x1, int y1){
-	for (int x = x0; x <= x1; x++)
-		for(int y = y0; y <= y1; y++)
-			clear_pixel(x, y);
-}
-
-void plot_pixel(int x, int y, short int line_color){
-    *(short int *)(pixel_buffer_start + (y << 10) + (x << 1)) = line_color;
-}
-
-void clear_pixel(int x, int y){
-    *(short int *)(pixel_buffer_start + (y << 10) + (x << 1)) = BACKGROUND + GRADIENT*y / RESOLUTION_Y;
-}
-
-void draw(Ball* ball, Dune* dune, Arrow* arrow, int score){
-	// check if the ball is even on the screen
-	draw_line(0, SCORE_LINE_Y, RESOLUTION_X-1, SCORE_LINE_Y, WHITE);
-	draw_score(score);
-	if (in_y_bounds(ball->y + ball->radius)){
-		draw_ball(ball);
-	}
-	else{
-		// update previous ball position anyways
-		ball->x2 = ball->x1;
-		ball->y2 = ball->y1;
-		ball->x1 = ball->x;
-		ball->y1 = ball->y;
-		// update and draw the arrow
-		update_arrow(arrow, ball->y);
-		draw_arrow(arrow);
-	}
-	if (toDraw > 0){
-		if (toDraw > FRAMES_2500-2)
-			draw_2500(X_2500, Y_2500, WHITE);
-		toDraw--;
-		if (toDraw == 0)
-			toClear = 2;
-	}
-	draw_dune_slice(dune, BALL_X-BALL_R, BALL_X+BALL_R);
-}
-
-double distance(int x1, int y1, int x2, int y2);
-
-void draw_ball(Ball* ball){	
-	// update ball position
-	ball->x2 = ball->x1;
-	ball->y2 = ball->y1;
-	ball->x1 = ball->x;
-	ball->y1 = ball->y;
-	
-	int r = ball->radius;
-	int xc = ball->x; // x center
-	int yc = ball->y; // y center
-	int color = ball->color;
-    int x = r, y = 0;
-      
-	// plot horizontal and vertical diameters of the circle
-	if (in_y_bounds(yc)){
-		for (int i = -x; i <= x; i++){
-			plot_pixel(xc+i, yc, color);
-		}
-	}
-      
-    // Initialising the value of P
-    int P = 1 - r;
-    while (x > y){ 
-        y++;  
-        if (P <= 0){ // midpoint is inside or on the permiter
-            P = P + 2*y + 1;
-		}
-        else{ // midpoint is outside the perimeter
-            x--;
-            P = P + 2*y - 2*x + 1;
-        }
-          
-        // All the perimeter points have already been drawn
-        if (x < y)
-            break;
-          
-        // draw lines
-		if (in_y_bounds(yc+y)){
-			draw_line(xc-x, yc+y, xc+x, yc+y, color);
-			//for (int i = -x; i <= x; i++){
-			//	plot_pixel(xc+i, yc+y, color);
-			//}	
-		}
-		if (in_y_bounds(yc-y)){
-			for (int i = -x; i <= x; i++){
-				plot_pixel(xc+i, yc-y, color);
-			}	
-		}
-		
-		// draw second pair of lines if we aren't on the edge of the octant
-        if (x != y){
-			if (in_y_bounds(yc+x)){
-				for (int i = -y; i <= y; i++){
-					plot_pixel(xc+i, yc+x, color);
-				}	
-			}
-			if (in_y_bounds(yc-x)){
-				for (int i = -y; i <= y; i++){
-					plot_pixel(xc+i, yc-x, color);
-				}	
-			}
-        }
-    } 
-}
-
-void clear_ball(Ball* ball){	
-	int r = ball->radius;
-	int xc = ball->x2; // x center 2 frames ago
-	int yc = ball->y2; // y center 2 frames ago
-    int x = r, y = 0;
-      
-	// plot horizontal and vertical diameters of the circle
-	if (in_y_bounds(yc)){
-		for (int i = -x; i <= x; i++){
-			clear_pixel(xc+i, yc);
-		}
-	}
-      
-    // Initialising the value of P
-    int P = 1 - r;
-    while (x > y){ 
-        y++;  
-        if (P <= 0){ // midpoint is inside or on the permiter
-            P = P + 2*y + 1;
-		}
-        else{ // midpoint is outside the perimeter
-            x--;
-            P = P + 2*y - 2*x + 1;
-        }
-          
-        // All the perimeter points have already been drawn
-        if (x < y)
-            break;
-          
-        // draw lines
-		if (in_y_bounds(yc+y)){
-			for (int i = -x; i <= x; i++){
-				clear_pixel(xc+i, yc+y);
-			}	
-		}
-		if (in_y_bounds(yc-y)){
-			for (int i = -x; i <= x; i++){
-				clear_pixel(xc+i, yc-y);
-			}	
-		}
-		
-		// draw second pair of lines if we aren't on the edge of the octant
-        if (x != y){
-			if (in_y_bounds(yc+x)){
-				for (int i = -y; i <= y; i++){
-					clear_pixel(xc+i, yc+x);
-				}	
-			}
-			if (in_y_bounds(yc-x)){
-				for (int i = -y; i <= y; i++){
-					clear_pixel(xc+i, yc-x);
-				}	
-			}
-        }
-    } 
-}
-
-void draw_dune(Dune* dune){
-	for(int i = 0; i < RESOLUTION_X; i++){
-		for(int j = 0; j < RESOLUTION_Y - dune->dunePoints[i]; j++){
-			plot_pixel(i, dune->dunePoints[i]+j, DUNE_COLOR);
-		}
-	}
-}
-
-void draw_dune_slice(Dune* dune, int x1, int x2){
-	for(int i = x1; i <=x2; i++){
-		int y_max = RESOLUTION_Y - dune->dunePoints[i];
-		for(int j = 0; j < y_max; j++){
-			plot_pixel(i, dune->dunePoints[i]+j, DUNE_COLOR);
-		}
-	}
-}
-
-void clear_running_dune(Dune* dune){
-	for(int x = 0; x < RESOLUTION_X; x++){
-		if(dune->dunePoints[x] > dune->dunePoints2[x]){
-			clear_line(x, dune->dunePoints2[x],x, dune->dunePoints[x]);
-		}
-		else{
-			draw_line(x, dune->dunePoints2[x], x, dune->dunePoints[x], DUNE_COLOR);
-		}
-	}
-}
-
-void clear_all_dune(Dune* dune){
-	for(int x = 0; x < RESOLUTION_X; x++){
-		draw_line(x, dune->dunePoints2[x], x, RESOLUTION_Y, BLACK);
-	}
-}
-
-	
-void draw_isosceles_triangle(int h, int w, int x, int y, short int color);
-void clear_isosceles_triangle(int h, int w, int x, int y, short int color);
-void draw_arrow(Arrow* arrow){
-	// update previous frames
-	arrow->h2 = arrow->h1;
-	arrow->h1 = arrow->h;
-	
-	// draw the triangle
-	int half = arrow->h/2;
-	draw_isosceles_triangle(half, half, arrow->x, arrow->y, arrow->color);
-	// draw rest of arrow
-	for (int i = 0; i < half; i++){
-		for (int j = -half/5; j <= half/5; j++){
-			plot_pixel(arrow->x+j, arrow->y+half+i, arrow->color);	
-		}
-	}
-}
-
-void clear_arrow(Arrow* arrow){
-	// draw the triangle
-	int half = arrow->h2/2;
-	clear_isosceles_triangle(half, half, arrow->x, arrow->y, BLACK);
-	// draw rest of arrow
-	for (int i = 0; i < half; i++){
-		for (int j = -half/5; j <= half/5; j++){
-			clear_pixel(arrow->x+j, arrow->y+half+i);	
-		}
-	}
-}
-
-void draw_isosceles_triangle(int h, int w, int x, int y, short int color){
-	// x, y is tip of triangle
-	double slope = 2*h / w;
-	
-	// draw triangle from top down
-	for (int i = 0; i <= w; i++){
-		int dx = (int) round(i / slope);
-		for (int j = -dx; j <= dx; j++){
-			plot_pixel(x+j, y+i, color);
-		}
-	}
-}
-
-void clear_isosceles_triangle(int h, int w, int x, int y, short int color){
-	// x, y is tip of triangle
-	double slope = 2*h / w;
-	
-	// draw triangle from top down
-	for (int i = 0; i <= w; i++){
-		int dx = (int) round(i / slope);
-		for (int j = -dx; j <= dx; j++){
-			clear_pixel(x+j, y+i);
-		}
-	}
-}
-
-void update_arrow(Arrow* arrow, int y){
-	y = -(y+BALL_R); // distance from bottom of ball to top of screen
-	int height = (int) round(y*ARROW_SCALE + MIN_ARROW_HEIGHT);
-	arrow->h = min(MAX_ARROW_HEIGHT, height);
-	
-	// update arrow color
-	int r = 0x1F; // 31
-	int b = 0x1F - y/2;
-	int g = 0x3F;
-	if (b < 0){
-		b = 0;
-		g = max(0, g-(y-62)/2);
-	}
-	arrow->color = (r << 11) | (g << 5) | b;
-}
-
-int min(int a, int b){
-	if (a < b) return a;
-	else return b;
-}
-
-int max(int a, int b){
-	if (a < b) return b;
-	else return a;
-}
-
-double distance(int x1, int y1, int x2, int y2){
-	return sqrt(pow((x1-x2), 2) + pow((y1-y2), 2));
-}
-
-// helper functions
-bool in_bounds(int x, int y){
-	return in_y_bounds(y) && in_x_bounds(x);	
-}
-
-bool in_y_bounds(int y){
-	return (y >= 0) && (y < RESOLUTION_Y);	
-}
-bool in_x_bounds(int x){
-	return (x >= 0) && (x < RESOLUTION_X);
-}
-
-//return true if ball is touching dune
-bool isBallTouchingDune(Ball* ball, Dune* dune){
-	if(ball->y > RESOLUTION_Y) return true;
-	for(int i = 0; i < ball->radius; i++){
-		if((ball->y + ball->radius) > dune->dunePoints[ball->x+i]) return true;
-		if((ball->y + ball->radius) > dune->dunePoints[ball->x-i]) return true;
-	}
-	return false;
-		
-}
-
-void draw_DUNE(short int color);
-void draw_press_space_to_start(int x, int y, short int color);
-void draw_starting_screen(){
-    //moving ball
-	static int calculation = 1;
-	double accel = 1;
-    static Ball ball = {.x = BALL_X, .y = BALL_Y, .dx = 0, .dy = 0, .color = WHITE, .radius = BALL_R,
-						.x1 = BALL_X, .y1 = BALL_Y, .x2 = BALL_X, .y2 = BALL_Y};
-	ball.color = set_ball_color();
-    static Dune dune;
-	int x = 0;
-	int amplitude;
-    if(calculation){
-		while(x < RESOLUTION_X){
-     		if(x <= DUNE_PERIOD) amplitude = 20;
-			else amplitude = 10;
-    		dune.dunePoints[x] = (int) amplitude*sin(DUNE_FREQUENCY*(x)) + 200;
-  			dune.duneAngles[x] = atan(amplitude*DUNE_FREQUENCY*cos(DUNE_FREQUENCY*(x)));
-        	x++;
-		}
-		calculation = 0;
-		draw_press_space_to_start(83, 120,WHITE);
-	}
-    draw_DUNE(WHITE);
-	
-	clear_ball(&ball);
-    draw_ball(&ball);
-    draw_dune(&dune);
-        
-        
-   	if(isBallTouchingDune(&ball,&dune)){
-		for(int i = 0; i < ball.radius; i++){
-			if(ball.y+ball.radius > dune.dunePoints[ball.x+i]) ball.y = dune.dunePoints[ball.x+i]-ball.radius;
-			if(ball.y+ball.radius > dune.dunePoints[ball.x-i]) ball.y = dune.dunePoints[ball.x-i]-ball.radius;
-		}
-		double angle = dune.duneAngles[ball.x];
-        double speed = sqrt(ball.dx*ball.dx + ball.dy*ball.dy)*cos(angle);
-		ball.dx = speed*cos(angle);
-		ball.dy = speed*sin(angle);
-		ball.y += ball.dy + 0.5*accel;
-		ball.x += ball.dx;
-    }
-    else{
-      	ball.y += (int) ball.dy + 0.5*accel;
-       	ball.dy += accel;
-		ball.x += ball.dx;
-    }
-
-	if(!in_bounds(ball.x,ball.y)){
-		ball.x = BALL_X;
-		ball.y = 0;
-		ball.dy = sqrt(ball.dx*ball.dx + ball.dy*ball.dy);
-		ball.dx = 0;
-	}
-}
-
-void draw_vertical(int x0, int y0, int x1, int y1, short int line_color);
-void draw_horizontal(int x0, int y0, int x1, int y1, short int line_color);
-void draw_line(int x0, int y0, int x1, int y1, short int line_color){
-	if (x0 == x1){
-		draw_vertical(x0, y0, x1, y1, line_color);
-		return;
-	}
-	else if (y0 == y1) {
-		draw_horizontal(x0, y0, x1, y1, line_color);
-		return;	
-	}
-    int is_steep = ((ABS(y1-y0) > ABS(x1-x0))? 1 : 0); 
-    if(is_steep){ //swap the variable around if the line is steep
-        int temp = y0;
-        y0 = x0;
-        x0 = temp;
-        temp = y1;
-        y1 = x1;
-        x1 = temp;
-    }
-    if(x0 > x1){  // we want to draw from smallest to biggest for simplicity
-        int temp = x1;
-        x1 = x0;
-        x0 = temp;
-        temp = y1;
-        y1 = y0;
-        y0 = temp;
-    }
-    
-    int deltaX = x1 - x0;   
-    int deltaY = ABS(y1 - y0);
-    int error = -(deltaX/2); //error
-    int x = x0;
-    int y = y0;
-    int y_step;  //add if y0 is below, but substract is y0 is above
-    if(y0 < y1) y_step = 1;
-    else y_step = -1;
-        
-    while(x<=x1){
-        if(is_steep) plot_pixel(y,x,line_color); //draw the pixel
-        else plot_pixel(x,y,line_color); 
-        x++;
-        error = error + deltaY; //determine if we need to increment y or not
-        if(error >= 0){
-             y = y + y_step;
-             error = error - deltaX;
-        }
-    }
-    
-    //if(is_steep) plot_pixel(y,x,line_color); //draw the last pixel
-    //else plot_pixel(x,y,line_color); 
-}
-
-void draw_vertical(int x0, int y0, int x1, int y1, short int line_color){
-	if (y0 > y1){
-		int temp = y0;
-		y0 = y1;
-		y1 = temp;
-	}
-	
-	for (int y = y0; y <=y1; y++){
-		plot_pixel(x0, y, line_color);
-	}
-}
-void draw_horizontal(int x0, int y0, int x1, int y1, short int line_color){
-	if (x0 > x1){
-		int temp = x0;
-		x0 = x1;
-		x1 = temp;
-	}
-	
-	for (int x = x0; x <=x1; x++){
-		plot_pixel(x, y0, line_color);
-	}	
-}
-
-void clear_vertical(int x0, int y0, int x1, int y1);
-void clear_horizontal(int x0, int y0, int x1, int y1);
-void clear_line(int x0, int y0, int x1, int y1){
-	if (x0 == x1){
-		clear_vertical(x0, y0, x1, y1);
-		return;
-	}
-	else if (y0 == y1) {
-		clear_horizontal(x0, y0, x1, y1);
-		return;	
-	}
-	
-    int is_steep = ((ABS(y1-y0) > ABS(x1-x0))? 1 : 0); 
-    if(is_steep){ //swap the variable around if the line is steep
-        int temp = y0;
-        y0 = x0;
-        x0 = temp;
-        temp = y1;
-        y1 = x1;
-        x1 = temp;
-    }
-    if(x0 > x1){  // we want to draw from smallest to biggest for simplicity
-        int temp = x1;
-        x1 = x0;
-        x0 = temp;
-        temp = y1;
-        y1 = y0;
-        y0 = temp;
-    }
-    
-    int deltaX = x1 - x0;   
-    int deltaY = ABS(y1 - y0);
-    int error = -(deltaX/2); //error
-    int x = x0;
-    int y = y0;
-    int y_step;  //add if y0 is below, but substract is y0 is above
-    if(y0 < y1) y_step = 1;
-    else y_step = -1;
-        
-    while(x<=x1){
-        if(is_steep) clear_pixel(y,x); //draw the pixel
-        else clear_pixel(x,y); 
-        x++;
-        error = error + deltaY; //determine if we need to increment y or not
-        if(error >= 0){
-             y = y + y_step;
-             error = error - deltaX;
-        }
-    }
-    
-    //if(is_steep) plot_pixel(y,x,line_color); //draw the last pixel
-    //else plot_pixel(x,y,line_color); 
-}
-
-void clear_vertical(int x0, int y0, int x1, int y1){
-	if (y0 > y1){
-		int temp = y0;
-		y0 = y1;
-		y1 = temp;
-	}
-	
-	for (int y = y0; y <=y1; y++){
-		clear_pixel(x0, y);
-	}
-}
-void clear_horizontal(int x0, int y0, int x1, int y1){
-	if (x0 > x1){
-		int temp = x0;
-		x0 = x1;
-		x1 = temp;
-	}
-	
-	short int line_color = (short int) BACKGROUND + GRADIENT*y0 / RESOLUTION_Y;
-	for (int x = x0; x <=x1; x++){
-		plot_pixel(x, y0, line_color);
-	}	
-}
-
-void display_score(int score){
-	// extract the digits
-	int digits[6];
-	for (int i = 0; i < 6; i++){
-		digits[i] = (score % 10);
-		score /= 10;
-	}
-	
-	// define hex base
-	volatile int * HEX3_HEX0_ptr = (int *)HEX3_HEX0_BASE;
-	volatile int * HEX5_HEX4_ptr = (int *)HEX5_HEX4_BASE;
-
-	unsigned char hex_segs[] = {0, 0, 0, 0, 0, 0, 0, 0};
-	unsigned int shift_buffer, nibble;
-	shift_buffer = (digits[5] << 20) | (digits[4] << 16) | (digits[3] << 12) 
-		| (digits[2] << 8) | (digits[1] << 4) | digits[0];
-	
-	for (int i = 0; i < 6; ++i) {
-		nibble = shift_buffer & 0x0000000F; // character is in rightmost nibble
-		hex_segs[i] = seven_seg_decode_table[nibble];
-		shift_buffer = shift_buffer >> 4;
-	}
-	/* drive the hex displays */
-	*(HEX3_HEX0_ptr) = *(int *)(hex_segs);
-	*(HEX5_HEX4_ptr) = *(int *)(hex_segs + 4);
-
-}
-
-void receive_bytes(int n){
-	volatile int * PS2_ptr = (int *)PS2_BASE;
-	int received  = 0;
-	while (received < n) {
-		int PS2_data = *(PS2_ptr); 
-		int RVALID = PS2_data & 0x8000; // extract the RVALID field
-		if (RVALID) {
-			char byte = PS2_data & 0xFF;
-			printf("Received %X from keyboard reset\n", byte);
-			received++;
-		}
-	}
-}
-
-void space_key_clicked(bool* flag){
-	volatile int * PS2_ptr = (int *)PS2_BASE;
-	int PS2_data, RVALID, RAVAIL;
-	bool makeFlag = false;
-	bool breakFlag = false;
-	char byte;
-	
-	PS2_data = *(PS2_ptr); 
-	RAVAIL = (PS2_data & 0xFFFF0000) >> 16;
-	RVALID = (PS2_data & 0x8000);
-	if (!RVALID){
-		return;
-	}
-	
-	byte = PS2_data & 0xFF;
-	if (byte == 0x29){
-		makeFlag = true;
-	}
-	else if (byte == 0xF0){
-		breakFlag = true;
-	}
-	
-	for (int i = 0; i < RAVAIL; i++){
-		PS2_data = *(PS2_ptr);
-		byte = PS2_data & 0xFF;
-		if (byte == 0x29){
-			makeFlag = true;
-		}
-		else if (byte == 0xF0){
-			breakFlag = true;
-		}
-	}
-	
-	if (breakFlag){
-		*flag = false;
-	}
-	else if (makeFlag){
-		*flag = true;
-	}
-}
-	
-// read from switches
-int read_SW(){
-	volatile int* SW_ptr = (int*) SW_BASE;
-	return *SW_ptr;
-}
-
-short int set_ball_color(){
-	int sel = read_SW();
-	if (sel == 0){
-		return RED;
-	}
-	
-	int i = 0;
-	while ((sel & 0x1) != 1 && (i < 10)){
-		sel /= 2;
-		i++;
-	}
-	if (i >= 10) return RED;
-	else return ball_colors[i];
-}
-
-void draw_DUNE(short int color){
-	//letters start at x=56 to 264
-    //letters are 42 wide and 82 tall, with 5 blank each side, thickness of 7
-    //letters are drawn from y = 24 to y = 106, middle is at 66
-    
-    //draw DUNE letters
-    //letter D, goes from x =[61,103]
-	for(int y = 0; y <= 42; y++){
-         int x = (int) sqrt(1764 - y*y);
-         draw_line(60, 65+y, 60+x , 65+y, color);
-         draw_line(60, 65-y, 60+x , 65-y, color);
-	}
-    for(int y = 0; y <= 28; y++){
-		 int x = (int) sqrt(784 - y*y);
-         clear_line(67, 65+y, 67+x, 65+y);
-         clear_line(67, 65-y, 67+x, 65-y);
-	}
-    //letter U, goes from x = [113,155]
-    for(int x = 113; x <= 120; x++){
-         draw_line(x, 24, x, 106, color);
-    } 
-    for(int x = 121; x < 148; x++){
-         draw_line(x, 99, x, 106, color);
-    }
-	for(int x = 148; x <= 155; x++){
-         draw_line(x, 24, x, 106, color);
-    }
-    //letter N x = [165, 207]
-    for(int x = 165; x <= 172; x++){
-         draw_line(x, 24, x, 106, color);
-    }
-    for(int i = 0; i<=7; i++){
-	     draw_line(173,24+i, 200,99+i, color);
-    }
-    for(int x = 200; x <= 207; x++){
-         draw_line(x, 24, x, 106, color);
-    }
-    //letter E x= [217, 259]
-    for(int x = 217; x <= 224; x++){
-         draw_line(x, 24, x, 106, color);
-    }
-    for(int y = 24; y<=31; y++){
-     	draw_line(225, y, 259, y, color);
-		draw_line(225, y+38, 259, y+38, color);
-        draw_line(225, y+75, 259, y+75, color);
-	}
-}
-
-void draw_P(int x, int y, short int color){
-	draw_line(x, y, x, y+10, color);
-	draw_line(x, y, x+5, y, color);
-	draw_line(x, y+5, x+5, y+5, color);
-	x+=5;
-	draw_line(x, y, x, y+5, color);
-}
-
-void draw_R(int x, int y, short int color){
-	draw_line(x, y, x, y+10, color);
-	draw_line(x, y, x+5, y, color);
-	draw_line(x, y+5, x+5, y+5, color);
-	draw_line(x+5, y, x+5, y+5, color);
-	draw_line(x, y+5, x+5, y+10, color);
-}
-
-void draw_E(int x, int y, short int color){
-	draw_line(x, y, x, y+10, color);
-	draw_line(x, y, x+5, y, color);
-	draw_line(x, y+5, x+5, y+5, color);
-	draw_line(x, y+10, x+5, y+10, color);
-}
-
-//same for S and 5
-void draw_S(int x, int y, short int color){
-	draw_line(x, y, x, y+5, color);
-	draw_line(x, y, x+5, y, color);
-	draw_line(x, y+5, x+5, y+5, color);
-	draw_line(x, y+10, x+5, y+10, color);
-	draw_line(x+5, y+5, x+5, y+10, color);
-}
-
-void draw_A(int x, int y, short int color){
-	draw_line(x, y, x, y+10, color);
-	draw_line(x+5, y, x+5, y+10, color);
-	draw_line(x, y, x+5, y, color);
-	draw_line(x, y+5, x+5, y+5, color);
-}
-
-void draw_C(int x, int y, short int color){
-	draw_line(x, y, x, y+10, color);
-	draw_line(x, y, x+5, y, color);
-	draw_line(x, y+10, x+5, y+10, color);
-}
-
-void draw_T(int x, int y, short int color){
-	draw_line(x, y, x+5, y, color);
-	draw_line(x+2, y, x+2, y+10, color);
-}
-
-//draw 0 and O
-void draw_O(int x, int y, short int color){
-	draw_line(x, y, x, y+10, color);
-	draw_line(x, y, x+5, y, color);
-	draw_line(x, y+10, x+5, y+10, color);
-	draw_line(x+5, y, x+5, y+10, color);
-}
-
-void draw_quote(int x, int y, short int color){
-	draw_line(x+1, y, x+1, y+2, color);
-	draw_line(x+3, y, x+3, y+2, color);
-}
-
-void draw_I(int x, int y, short int color){
-	draw_line(x+2, y, x+2, y+10,color);
-	draw_line(x, y, x+5, y, color);
-	draw_line(x, y+10, x+5, y+10, color);
-}
-
-void draw_N(int x, int y, short int color){
-	draw_line(x, y, x, y+10, color);
-	draw_line(x+5, y, x+5, y+10, color);
-	draw_line(x, y, x+5, y+10, color);
-}
-
-void draw_G(int x, int y, short int color){
-	draw_line(x, y, x, y+10, color);
-	draw_line(x, y, x+5, y, color);
-	draw_line(x+3, y+5, x+5, y+5, color);
-	draw_line(x, y+10, x+5, y+10, color);
-	draw_line(x+5, y+5, x+5, y+10, color);
-}
-
-void draw_M(int x, int y, short int color){
-	draw_line(x, y, x, y+10, color);
-	draw_line(x+5, y, x+5, y+10, color);
-	draw_line(x, y, x+2, y+5, color);
-	draw_line(x+3, y+5, x+5, y, color);
-}
-
-void draw_V(int x, int y, short int color){
-	draw_line(x, y, x+2, y+10, color);
-	draw_line(x+3, y+10, x+5, y, color);
-}
-
-void draw_two_points(int x, int y, short int color){
-	draw_line(x+1, y+2, x+1, y+4, color);
-	draw_line(x+2, y+2, x+2, y+4, color);
-	draw_line(x+1, y+6, x+1, y+8, color);
-	draw_line(x+2, y+6, x+2, y+8, color);
-}
-	
-void draw_1(int x, int y, short int color){
-	draw_line(x+2, y, x+2, y+10,color);
-	draw_line(x, y+2, x+2, y,color);
-	draw_line(x, y+10, x+5, y+10, color);
-}
-
-void draw_2(int x, int y, short int color){
-	draw_line(x+5, y, x+5, y+5, color);
-	draw_line(x, y, x+5, y, color);
-	draw_line(x, y+5, x+5, y+5, color);
-	draw_line(x, y+10, x+5, y+10, color);
-	draw_line(x, y+5, x, y+10, color);
-}
-
-void draw_3(int x, int y, short int color){
-	draw_line(x+5, y, x+5, y+10, color);
-	draw_line(x, y, x+5, y, color);
-	draw_line(x, y+5, x+5, y+5, color);
-	draw_line(x, y+10, x+5, y+10, color);
-}
-
-void draw_4(int x, int y, short int color){
-	draw_line(x+5, y, x+5, y+10, color);
-	draw_line(x, y, x, y+5, color);
-	draw_line(x, y+5, x+5, y+5, color);
-}
-
-void draw_6(int x, int y, short int color){
-	draw_line(x, y, x, y+10, color);
-	draw_line(x, y, x+5, y, color);
-	draw_line(x, y+5, x+5, y+5, color);
-	draw_line(x, y+10, x+5, y+10, color);
-	draw_line(x+5, y+5, x+5, y+10, color);
-}
-
-void draw_7(int x, int y, short int color){
-	draw_line(x+5, y, x+5, y+10, color);
-	draw_line(x, y, x, y+5, color);
-	draw_line(x, y, x+5, y, color);
-}
-
-void draw_8(int x, int y, short int color){
-	draw_line(x, y, x, y+10, color);
-	draw_line(x+5, y, x+5, y+10, color);
-	draw_line(x, y, x+5, y, color);
-	draw_line(x, y+5, x+5, y+5, color);
-	draw_line(x, y+10, x+5, y+10, color);
-}
-
-void draw_9(int x, int y, short int color){
-	draw_line(x, y, x, y+5, color);
-	draw_line(x+5, y, x+5, y+10, color);
-	draw_line(x, y, x+5, y, color);
-	draw_line(x, y+5, x+5, y+5, color);
-	draw_line(x, y+10, x+5, y+10, color);
-}
-
-void draw_press_space_to_start(int x, int y, short int color){
-	draw_P(x, y, color);
-	x+=7;
-	draw_R(x, y, color);
-	x+=7;
-	draw_E(x, y, color);
-	x+=7;
-	draw_S(x, y, color);
-	x+=7;
-	draw_S(x, y, color);
-	x+=14;
-	draw_quote(x, y, color);
-	x+=7;
-	draw_S(x, y, color);
-	x+=7;
-	draw_P(x, y, color);
-	x+=7;
-	draw_A(x, y, color);
-	x+=7;
-	draw_C(x, y, color);
-	x+=7;
-	draw_E(x, y, color);
-	x+=7;
-	draw_quote(x, y, color);
-	x+=14;
-	draw_T(x, y, color);
-	x+=7;
-	draw_O(x, y, color);
-	x+=14;
-	draw_S(x, y, color);
-	x+=7;
-	draw_T(x, y, color);
-	x+=7;
-	draw_A(x, y, color);
-	x+=7;
-	draw_R(x, y, color);
-	x+=7;
-	draw_T(x, y, color);
-	x+=7;
-}
-
-void draw_game_over(int x, int y, short int color){
-	draw_G(x,y,color);
-	x+=7;
-	draw_A(x,y,color);
-	x+=7;
-	draw_M(x,y,color);
-	x+=7;
-	draw_E(x,y,color);
-	x+=14;
-	draw_O(x,y,color);
-	x+=7;
-	draw_V(x,y,color);
-	x+=7;
-	draw_E(x,y,color);
-	x+=7;
-	draw_R(x,y,color);
-	x+=7;
-}
-
-void draw_score(int points){
-	int x = RESOLUTION_X - 11;
-	int y = 5;
-	if(points == 0){
-		draw_O(x,y,WHITE);
-		x-= 7;
-		points = points/10;
-	}
-	while(points!=0){
-		int number = points%10;
-		if(number == 1) draw_1(x,y,WHITE);
-		else if(number == 2) draw_2(x,y,WHITE);
-		else if(number == 3) draw_3(x,y,WHITE);
-		else if(number == 4) draw_4(x,y,WHITE);
-		else if(number == 5) draw_S(x,y,WHITE);
-		else if(number == 6) draw_6(x,y,WHITE);
-		else if(number == 7) draw_7(x,y,WHITE);
-		else if(number == 8) draw_8(x,y,WHITE);
-		else if(number == 9) draw_9(x,y,WHITE);
-		else draw_O(x,y,WHITE);
-		x-= 7;
-		points = points/10;
-	}
-	
-	draw_two_points(x,y,WHITE);
-	x-=7;
-	draw_E(x,y,WHITE);
-	x-=7;
-	draw_R(x,y,WHITE);
-	x-=7;
-	draw_O(x,y,WHITE);
-	x-=7;
-	draw_C(x,y,WHITE);
-	x-=7;
-	draw_S(x,y,WHITE);
-}
-
-void draw_game_over_screen(Ball* ball, Dune* dune, int points, int frames){
-	draw_background();
-	draw_line(0, SCORE_LINE_Y, RESOLUTION_X-1, SCORE_LINE_Y, WHITE);
-	draw_ball(ball);
-	draw_dune(dune);	
-	draw_game_over(130, 40,WHITE);
-	if (frames % 2 == 1) draw_press_space_to_start(83, 80, WHITE);
-	draw_score(points);
-}
-
-void draw_2500(int x, int y, short int color){
-	// draw the plus sign
-	draw_line(x, y+3, x+5, y+3, WHITE);
-	draw_line(x+3, y+1, x+3, y+6, WHITE);
-	x+=7;
-	draw_2(x,y,color);
-	x+=7;
-	draw_S(x,y,color);
-	x+=7;
-	draw_O(x,y,color);
-	x+=7;
-	draw_O(x,y,color);
-	x+=7;
-}
-	
-
-
-
-	
-
-
+/* This files provides address values that exist in the system */
+
+#define SDRAM_BASE            0xC0000000
+#define FPGA_ONCHIP_BASE      0xC8000000
+#define FPGA_CHAR_BASE        0xC9000000
+
+/* Cyclone V FPGA devices */
+#define LEDR_BASE             0xFF200000
+#define HEX3_HEX0_BASE        0xFF200020
+#define HEX5_HEX4_BASE        0xFF200030
+#define SW_BASE               0xFF200040
+#define KEY_BASE              0xFF200050
+#define TIMER_BASE            0xFF202000
+#define PIXEL_BUF_CTRL_BASE   0xFF203020
+#define CHAR_BUF_CTRL_BASE    0xFF203030
+#define PS2_BASE              0xFF200100
+#define JTAG_UART_BASE        0xFF201000
+#define AUDIO_BASE            0xFF203040
+
+/* Cortex-A9 MPCore */
+#define MPCORE_PRIV_TIMER     0xFFFEC600
+
+
+/* VGA colors */
+#define WHITE 0xFFFF
+#define BLACK 0x0000
+#define YELLOW 0xFFE0
+#define RED 0xF800
+#define GREEN 0x07E0
+#define BLUE 0x001F
+#define CYAN 0x07FF
+#define MAGENTA 0xF81F
+#define GREY 0xC618
+#define PINK 0xFC18
+#define ORANGE 0xFC00
+#define BACKGROUND 0x0570
+#define GRADIENT 15
+#define DUNE_COLOR 0xFFB5
+#define NUM_BALL_COLORS 10
+	
+#define ABS(x) (((x) > 0) ? (x) : -(x))
+
+
+/* Screen size. */
+#define RESOLUTION_X 320
+#define RESOLUTION_Y 240
+
+// Ball location parameters
+#define BALL_X 20
+#define BALL_Y 10
+#define BALL_R 3
+// difficulty can be overridden when compiling, e.g. -DMAX_SPEED=30 for sweeps
+#ifndef MAX_SPEED
+#define MAX_SPEED 25
+#endif
+#ifndef MAX_ACCELERATION
+#define MAX_ACCELERATION 3
+#endif
+#ifndef MIN_ACCELERATION
+#define MIN_ACCELERATION 1
+#endif
+
+//Dune parameters
+#define NUM_DUNES 15 //more than 3 plz
+#define MIDDLE_DUNE 180 //Highest point is 2/3 of Y, lowest point is 1/10 of Y, mid point is 23/60 of Y
+#ifndef MAX_AMPLITUDE_DUNE
+#define MAX_AMPLITUDE_DUNE 50 // from analysis, must be bigger than 10
+#endif
+#define DUNE_FREQUENCY 3.1415926535897/80  // two dunes on the screen at all times
+#define DUNE_PERIOD 160 //half of the screen
+#define TERRAIN_STORE (NUM_DUNES*DUNE_PERIOD + RESOLUTION_X) // the terrain and a copy of its first screen
+#define TERRAIN_CHUNK 64 // columns built per idle step while the title shows
+#define PI 3.1415926535897
+
+
+// arrow parameters
+#define ARROW_SCALE 0.3	// height per pixel out of bounds
+#define MIN_ARROW_HEIGHT 20
+#define MAX_ARROW_HEIGHT 60
+	
+// other PARAMETERS
+#define SCORE_LINE_Y 60
+#define X_2500 BALL_X + MAX_ARROW_HEIGHT/2
+#define Y_2500 SCORE_LINE_Y-15
+#define FRAMES_2500 12// must be greater than 2
+
+// HUD text: stroked glyphs in a GLYPH_W by GLYPH_H box, GLYPH_ADVANCE apart
+#define GLYPH_W 6
+#define GLYPH_H 11
+#define GLYPH_ADVANCE 7
+#define HUD_X (RESOLUTION_X-11) // last digit of the score line
+#define HUD_Y 5
+// glyphs cached as bit masks: the digits, then what else the score line and
+// +2500 use; O and S are 0 and 5
+#define GLYPH_COLON 10
+#define GLYPH_E 11
+#define GLYPH_R 12
+#define GLYPH_C 13
+#define GLYPH_PLUS 14
+#define GLYPHS 15
+#define HUD_GLYPHS 16 // "SCORE:" and the digits of any int
+#define HUD_WORDS ((HUD_GLYPHS*GLYPH_ADVANCE + 31)/32) // 32 pixel words in a row of the score line
+
+// parallax layers behind the dunes
+#define LAYER_PERIOD 480 // the layers repeat every LAYER_PERIOD pixels
+#define LAYER_STORE (LAYER_PERIOD + RESOLUTION_X) // a strip and a copy of its first screen
+#define LAYER_BOTTOM (MIDDLE_DUNE - MAX_AMPLITUDE_DUNE) // highest point of the dunes, the layers are above it
+#define CLOUD_BOTTOM (LAYER_BOTTOM*2/5) // clouds above this row, far dunes below it
+#define CLOUD_SHIFT 3 // clouds scroll at currentX/8
+#define FAR_DUNE_SHIFT 2 // far dunes scroll at currentX/4
+#define CLOUD_COLOR 0xE79D
+#define FAR_DUNE_COLOR 0x8692
+#define FAR_DUNE_FADE 32 // rows over which the far dunes fade into the sky at LAYER_BOTTOM
+
+// input recording and replay
+#define INPUT_LIVE 0	// read the switches and keyboard
+#define INPUT_RECORD 1	// read the hardware and log every frame to input_trace
+#define INPUT_REPLAY 2	// feed the frames in input_trace back instead of the hardware
+#define INPUT_SCRIPT 3	// fixed pattern: start the game, then hold space SCRIPT_HOLD of every SCRIPT_PERIOD frames
+#define SCRIPT_START 10
+#define SCRIPT_PERIOD 40
+#define SCRIPT_HOLD 15
+#define MAX_TRACE_FRAMES 65536 // about 18 minutes at 60 frames per second
+#define TRACE_HEADER_SIZE 16
+#define TRACE_VERSION 1
+#define TRACE_SPACEBAR 0x8000 // bit set in a frame record while space is held
+#define DEFAULT_TERRAIN_SEED 1
+
+// headless batch simulation (host build)
+#define SWEEP_FRAMES 10000 // longest run simulated for one instance
+
+// attract mode: the autopilot plays once the title screen has waited ATTRACT_DELAY frames
+#define ATTRACT_DELAY 600 // 10 seconds
+#define ATTRACT_RESTART 60 // game over frames before the autopilot plays again
+#define AUTOPILOT_PLANS 9 // forks of the world played ahead every frame
+#define AUTOPILOT_HORIZON 32 // frames each fork is played ahead
+
+// audio: mixed in blocks ahead of time, fed to the codec FIFO in bursts; the
+// rate is the codec's, 48 kHz on the DE1-SoC, set it to 8000 for CPUlator's
+#ifndef AUDIO_RATE
+#define AUDIO_RATE 48000 // samples per second
+#endif
+#define AUDIO_FIFO 128 // samples the codec FIFO holds per channel
+#define AUDIO_BLOCK 32 // samples mixed at a time
+#define AUDIO_AHEAD_MS 64 // audio mixed ahead, waiting for the FIFO
+#define AUDIO_BLOCKS (AUDIO_RATE*AUDIO_AHEAD_MS/1000/AUDIO_BLOCK) // 16 at 8 kHz, 96 at 48 kHz
+#define AUDIO_DRAW_FEEDS 4 // top ups while drawing: before, after the sky, before the ball, after
+// and the rest while waiting for the swap, enough that at most a quarter of
+// the FIFO plays between two of them: 9 points a frame at 8 kHz, 30 at 48 kHz
+#define AUDIO_FEEDS (AUDIO_DRAW_FEEDS + AUDIO_RATE/60/(AUDIO_FIFO/4) + 1)
+#define AUDIO_BUDGET_NS 500000 // mixing stops for the frame once audio has taken this long
+#define AUDIO_CUE_LEVEL 6000
+
+// input latency tracing
+#define LATENCY_SAMPLES 256 // spacebar presses and releases kept for the report
+
+// per frame telemetry: a ring of fixed size chunks, each starting with a
+// TELEMETRY_CHUNK_HEADER byte header, so a reader can jump to any chunk
+#define TELEMETRY_HEADER_SIZE 16
+#define TELEMETRY_VERSION 1
+#define TELEMETRY_CHUNK 4096 // bytes per chunk, header included
+#define TELEMETRY_CHUNK_HEADER 8
+#define TELEMETRY_CHUNKS 256 // chunks in the ring, about 20 minutes of play
+#define TELEMETRY_MAX_RECORD 64 // longest encoded frame
+#define TELEMETRY_FIXED 256 // dx, dy and the scroll are kept in 1/256 pixel
+// values recorded every frame, in encoding order
+#define TELEMETRY_X 0
+#define TELEMETRY_Y 1
+#define TELEMETRY_DX 2
+#define TELEMETRY_DY 3
+#define TELEMETRY_SCROLL 4
+#define TELEMETRY_SCORE 5
+#define TELEMETRY_INPUT 6 // switches and TRACE_SPACEBAR, as in the input trace
+#define TELEMETRY_STEP 7 // us spent in advance_game
+#define TELEMETRY_RENDER 8 // us spent in render_frame
+#define TELEMETRY_SWAP 9 // us spent waiting for the swap
+#define TELEMETRY_FIELDS 10
+
+// idle time scheduling
+#define MAX_IDLE_TASKS 10
+
+// logging
+#define LOG_SLOTS 64 // messages held between drains
+#define LOG_LINE 80 // longest message, longer ones are cut short
+
+// band-parallel rasterization
+#define MAX_RASTER_THREADS 16 // the screen is split into at most this many horizontal bands
+
+// golden frame checks (host build)
+#define GOLDEN_OFF 0
+#define GOLDEN_RECORD 1	// write the hash of every presented frame
+#define GOLDEN_CHECK 2	// compare every presented frame against the hashes
+
+// game modes and the simulate/render frame queue
+#define MODE_TITLE 0
+#define MODE_PLAY 1
+#define MODE_GAME_OVER 2
+#define MODE_STOP 3	// no more frames, the renderer stops
+#define FRAME_QUEUE_SIZE 3 // one slot stays empty, so the simulation runs at most 2 frames ahead
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include <time.h>
+#include <stdint.h>
+#include <stdarg.h>
+
+#ifdef HOST_BUILD
+// host build: the pixel buffers and device registers are plain memory at
+// their bus addresses so the game can run headless on a Linux box
+#define HOST_BUFFER_SIZE 0x40000
+char host_onchip[HOST_BUFFER_SIZE];
+char host_sdram[2*HOST_BUFFER_SIZE]; // the game's buffer, then env_render's
+#define ENV_BUFFER (SDRAM_BASE + HOST_BUFFER_SIZE) // env_render draws here, so the game's buffers are left alone
+int host_io[0x1000]; // 0xFF200000 to 0xFF203FFF
+
+static inline char* host_bus(unsigned int addr){
+	if (addr - SDRAM_BASE < sizeof(host_sdram)) return host_sdram + (addr - SDRAM_BASE);
+	if (addr - FPGA_ONCHIP_BASE < HOST_BUFFER_SIZE) return host_onchip + (addr - FPGA_ONCHIP_BASE);
+	return (char *)&host_io[((addr - LEDR_BASE) >> 2) & 0xFFF];
+}
+#define BUS(addr) host_bus(addr)
+#else
+#define BUS(addr) ((char *)(addr))
+#endif
+// pointer to a device register
+#define IO(addr) ((volatile int *)BUS(addr))
+
+// useful structs
+typedef struct Ball {
+	int x, y;
+	double dx, dy;
+	int color;
+	int radius;
+	// variables to help clear buffer
+	int x1, y1; // position 1 frame ago
+	int x2, y2; // position 2 frames ago
+} Ball;
+
+// the dunes on screen, as windows into a terrain store; the store repeats
+// its first screen at the end, so a window never has to wrap
+typedef struct Dune{
+	const int* dunePoints; // heights of screen columns 0 to RESOLUTION_X-1
+	const double* duneAngles;
+	const int* dunePoints1; // window 1 frame ago
+	const int* dunePoints2; // window 2 frames ago, what the back buffer shows
+} Dune;
+
+// copy of a fully rendered frame and the buffer it belongs to
+typedef struct FrameSnapshot {
+	int buffer; // address of the pixel buffer
+	short int pixels[RESOLUTION_Y][RESOLUTION_X];
+} FrameSnapshot;
+
+// everything the physics step reads and writes
+typedef struct World {
+	Ball ball;
+	Dune dune; // terrain on screen
+	double currentX; // scroll position in the world terrain
+	const int* terrainPoints; // world terrain, TERRAIN_STORE columns from build_terrain
+	const double* terrainAngles;
+	const double* terrainHeights; // amplitude of each dune, NUM_DUNES of them
+} World;
+
+// many balls sharing the terrain, one array per field so the batch update
+// streams through memory; used for ghost riders and stress tests
+#define MAX_RIDERS 512
+typedef struct Riders {
+	int count;
+	double scroll[MAX_RIDERS]; // like World.currentX, the rider's centre is at scroll + BALL_X
+	double fromX[MAX_RIDERS]; // world position before the current step
+	double dx[MAX_RIDERS];
+	double dy[MAX_RIDERS];
+	int y[MAX_RIDERS];
+	bool spacebar[MAX_RIDERS]; // input for the next step
+	bool alive[MAX_RIDERS];
+	short int color[MAX_RIDERS];
+	// screen position drawn 1 and 2 frames ago, x is -1 when nothing was drawn
+	short int x1[MAX_RIDERS], y1[MAX_RIDERS];
+	short int x2[MAX_RIDERS], y2[MAX_RIDERS];
+} Riders;
+
+// grains of sand thrown up by the ball, one array per field like the riders;
+// positions are screen pixels in PARTICLE_FIXED fixed point
+#define MAX_PARTICLES 256
+typedef struct Particles {
+	int count; // live grains and dead ones still to be erased, in [0, count)
+	int cap; // grains allowed, lowered while the frame budget is tight
+	unsigned int seed;
+	double scroll; // currentX the grains were last moved to
+	int x[MAX_PARTICLES], y[MAX_PARTICLES];
+	int dx[MAX_PARTICLES], dy[MAX_PARTICLES]; // per frame, relative to the dunes
+	unsigned char life[MAX_PARTICLES]; // frames left, 0 once dead
+	short int color[MAX_PARTICLES];
+	// pixel drawn 1 and 2 frames ago, x is -1 when nothing was drawn
+	short int x1[MAX_PARTICLES], y1[MAX_PARTICLES];
+	short int x2[MAX_PARTICLES], y2[MAX_PARTICLES];
+} Particles;
+
+// note that this arrow will always be pointing upwards
+typedef struct Arrow {
+	int x, y; // location of arrow tip
+	int h; //current height
+	int h1; // 1 framge ago
+	int h2; // 2 frames ago
+	short int color;
+} Arrow;
+
+// one queued log message; turn is even while the slot is free for lap turn/2
+// and odd once that lap's message is written, so a zeroed ring is empty
+typedef struct LogSlot {
+	unsigned int turn;
+	char text[LOG_LINE];
+} LogSlot;
+
+// bounded ring of formatted messages; any thread may log, only the thread
+// waiting for vsync drains
+typedef struct LogRing {
+	LogSlot slots[LOG_SLOTS];
+	unsigned int head; // next message to write, claimed with compare-and-swap
+	unsigned int tail; // next message to drain
+	unsigned int dropped; // messages lost because the ring was full
+	unsigned int reported; // drops already announced
+	int offset; // characters of the tail message already sent
+} LogRing;
+
+// register accesses made through the device layer; read and written from
+// both the simulation and the renderer, so counted with atomic adds
+typedef struct DeviceStats {
+	unsigned int reads, writes;
+	unsigned int skipped; // shadowed writes of the value the register already holds
+	unsigned int cached; // switch reads answered from the cache
+	unsigned int frames;
+} DeviceStats;
+
+// timestamps in ns of one spacebar change on its way to the screen; only
+// differences are used, so the clock may wrap
+typedef struct LatencySample {
+	unsigned int input; // keyboard byte first seen, or the poll that read it
+	unsigned int step; // physics step with the new acceleration done
+	unsigned int render; // frame showing it drawn into the back buffer
+	unsigned int swap; // that buffer swapped to the front
+	bool shown;
+} LatencySample;
+
+// one frame of telemetry, as recorded after its swap
+typedef struct TelemetryFrame {
+	unsigned int frame; // frames recorded before this one
+	int mode;
+	int flags; // STEP_ flags of the physics step that produced the frame
+	int value[TELEMETRY_FIELDS]; // indexed by TELEMETRY_X and friends
+} TelemetryFrame;
+
+// encoder and decoder state: every value is stored as its difference from a
+// prediction made from the frames before it in the same chunk
+typedef struct TelemetryDelta {
+	int last[TELEMETRY_FIELDS];
+	int step[TELEMETRY_FIELDS]; // last change, for the fields that move steadily
+} TelemetryDelta;
+
+// the chunk being filled is chunks-1; on the host, finished chunks are
+// written out by an idle task
+typedef struct TelemetryWriter {
+	unsigned int chunks; // chunks started
+	unsigned int frames; // frames recorded
+	int offset; // next free byte of the current chunk
+	TelemetryDelta delta;
+	unsigned int written; // chunks written to the file
+	unsigned int lost; // chunks overwritten before they were written
+} TelemetryWriter;
+
+// walks a mapped telemetry file, or a dump of the board's ring, in recording order
+typedef struct TelemetryReader {
+	unsigned char* base;
+	size_t size;
+	unsigned int slots; // chunks the file has room for
+	unsigned int oldest; // slot of the first chunk
+	unsigned int chunks; // chunks holding frames
+	unsigned int chunk; // chunk being read, counted from the oldest
+	int offset; // next byte of it
+	int left; // frames left in it
+	unsigned int next; // number of the next frame
+	TelemetryDelta delta;
+} TelemetryReader;
+
+// the sounds being mixed and the blocks waiting for the codec; written only
+// by the renderer, which updates it, tops up the FIFO and mixes while it waits
+typedef struct AudioMixer {
+	short int blocks[AUDIO_BLOCKS][AUDIO_BLOCK];
+	unsigned int mixed; // blocks mixed so far
+	unsigned int fed; // samples written to the FIFO so far
+	unsigned int noise; // wind: white noise through a one pole low pass
+	int windLow;
+	int windLevel; // out of 256
+	unsigned int tonePhase; // speed tone: a triangle wave, phase in 1/2^32 of a period
+	unsigned int toneStep;
+	int toneLevel; // out of 256
+	int cue; // samples left of the jump or +2500 cue
+	unsigned int cuePhase; // square wave sweeping in pitch
+	unsigned int cueStep;
+	int cueSweep;
+	bool contact; // ball was on the dunes in the last frame
+	int point; // next feed point of the frame, 0 to AUDIO_FEEDS-1
+	// cost, measured with trace_ns around every audio call
+	unsigned int frames;
+	unsigned int frameNs; // spent on audio in the current frame
+	unsigned long long totalNs;
+	unsigned int maxNs;
+	unsigned int over; // frames over AUDIO_BUDGET_NS
+	unsigned int empty; // times the FIFO was found empty, so it probably ran dry
+} AudioMixer;
+
+typedef struct IdleTask {
+	const char* name;
+	bool (*step)(void* arg); // does a little work, false if there was nothing to do
+	void* arg;
+	int budget; // steps per frame at most
+	int used; // steps this frame
+	unsigned int steps; // steps so far, for the debugger
+} IdleTask;
+
+// the game's terrain is built TERRAIN_CHUNK columns at a time in idle time
+// while the title shows; build_terrain does it all at once for the tools
+typedef struct TerrainBuild {
+	int* points;
+	double* angles;
+	const double* heights;
+	int next; // columns [0, next) are built
+} TerrainBuild;
+
+// HUD sprites, built in idle time: bit masks of the glyphs, then one of the
+// score line for the score the next frame is likely to show
+typedef struct Hud {
+	unsigned char glyphs[GLYPHS][GLYPH_H]; // bit i of a row is its pixel at x + i
+	int cached; // glyphs [0, cached) have masks
+	int shown, previous; // scores of the last two frames, -1 for none
+	int score; // score the line is laid out for, -1 for none
+	int left, words; // x of bit 0 of the line, words used in each row
+	unsigned int line[GLYPH_H][HUD_WORDS]; // bit i of word w is pixel left + 32*w + i
+} Hud;
+
+// simulation side of the game: input, physics, score and mode changes
+typedef struct Game {
+	World world;
+	World initialWorld; // restored on restart
+	int points[TERRAIN_STORE];
+	double angles[TERRAIN_STORE];
+	double heights[NUM_DUNES];
+	TerrainBuild terrain; // how much of points and angles is built
+	int mode;
+	int score;
+	int gameOverFrames; // game over frames shown so far
+	int runFrames; // physics steps since the run started
+	bool spacebar;
+	bool restore; // the next frame starts from the initial frames
+	bool bonus; // ball crossed the score line, +2500 on the next frame
+	int latency; // latency sample for the next frame, -1 for none
+	int stepFlags; // STEP_ flags of the last physics step
+	unsigned int stepTime; // ns spent in the last advance_game
+	int titleFrames; // frames on the title screen
+	bool autopilot; // the run is the attract mode's
+} Game;
+
+// everything one frame draws; filled by the simulation, then only read by the renderer
+typedef struct GameFrame {
+	int mode;
+	bool restore; // put back the initial frames before drawing
+	bool bonus; // start showing +2500
+	int score;
+	int gameOverFrames;
+	Ball ball;
+	Dune dune;
+	double currentX;
+	int riderCount;
+	double riderScroll[MAX_RIDERS];
+	int riderY[MAX_RIDERS];
+	bool riderAlive[MAX_RIDERS];
+	int latency; // latency sample whose input this frame shows first, -1 for none
+	int stepFlags; // STEP_ flags of the physics step that produced the frame
+	unsigned int stepTime;
+	int input; // switches and TRACE_SPACEBAR that step used
+} GameFrame;
+
+// single producer, single consumer ring of frames from the simulation to the renderer
+typedef struct FrameQueue {
+	GameFrame slots[FRAME_QUEUE_SIZE];
+	int head __attribute__((aligned(64))); // next frame to draw, written by the renderer
+	int tail __attribute__((aligned(64))); // next slot to fill, written by the simulation
+} FrameQueue;
+
+// render side: what was drawn into the buffers, so it can be erased again
+typedef struct Renderer {
+	Ball ball; // with the positions drawn 1 and 2 frames ago
+	Arrow arrow;
+	Riders riders;
+	Particles particles;
+	int latency; // latency sample in the back buffer, stamped at the swap
+	TelemetryFrame telemetry; // frame in the back buffer, recorded at the swap
+} Renderer;
+
+// terrain of one environment, rebuilt only when the seed changes
+typedef struct DuneTerrain {
+	int points[TERRAIN_STORE];
+	double angles[TERRAIN_STORE];
+	double heights[NUM_DUNES];
+	unsigned int seed;
+	bool built;
+} DuneTerrain;
+
+// one run of the game for a control policy (host build): the real physics
+// and scoring with no devices, frame queue or drawing; read it directly
+typedef struct DuneEnv {
+	World world; // world.ball is the observation
+	int score;
+	int frames; // steps since the reset
+	int flags; // STEP_ flags of the last step
+	bool bonus; // ball crossed the score line, +2500 on the next step
+	bool done; // crashed or reached the top score, steps do nothing until a reset
+	unsigned int seed;
+} DuneEnv;
+
+// independent environments stepped together; the small per step state of
+// all of them is one array, the terrains they read are kept apart
+typedef struct DuneBatch {
+	int count;
+	DuneEnv* envs;
+	DuneTerrain* terrains;
+} DuneBatch;
+
+
+//functions we need to implement
+/*
+drawPixel();  // draws pixel at given location and color
+drawBackground(); // if possible
+drawDune(); // draws the dune on the screen
+drawBall();
+drawArrow();
+drawStartingScreen();
+drawScore(); //start the score on the screen
+drawGameOverScreen();
+gameOverCheck(); // check if the ball crashed or not
+inBounds function();
+updateGameInfo(); updates the position of the ball and the dunes before the next draw()
+clearScreen();
+wait_for_vsync();
+*/
+
+// physics
+#define STEP_CONTACT 1 // ball touched the dunes this frame
+#define STEP_CRASH 2 // ball hit a dune too steeply at top speed
+#define STEP_LANDED 4 // ball came down on the dunes after being in the air
+void reset_world(World* world, const int* points, const double* angles, const double* heights);
+double sweep_ball(const World* world, double x0, double y0, double dx, double dy);
+double terrain_height(const World* world, double x);
+int terrain_floor(const World* world, double x, int radius);
+double terrain_slope(const World* world, double x);
+int physics_step(World* world, bool spacebar);
+int add_score(int score, double dx, bool bonus);
+static inline int resolve_ball(const World* world, double fromX, double toX, int* y, double* dx, double* dy, int radius, double acceleration);
+
+// riders
+#define GHOST_RUNS 3 // previous runs replayed as ghosts
+#define GHOST_COLOR GREY
+void reset_riders(Riders* riders, int count);
+void riders_step(Riders* riders, const World* world);
+void draw_riders(Riders* riders, double currentX);
+void clear_riders(Riders* riders, Dune* dune);
+void record_run_input(int frame, bool spacebar);
+void save_ghost(int frames);
+void spawn_ghosts(Riders* riders);
+void ghost_inputs(Riders* riders, int frame);
+
+// particles
+#define PARTICLE_FIXED 256
+#define PARTICLE_GRAVITY (PARTICLE_FIXED*3/10) // per frame
+#define PARTICLE_SPRAY 24 // grains thrown up by a landing
+#define PARTICLE_LANDING_DY 6 // falling speed a landing needs to throw up sand
+#define PARTICLE_SPRAY_LIFE 30
+#define PARTICLE_TRAIL_DX 14 // ball speed above which it leaves a trail
+#define PARTICLE_TRAIL 3 // trail grains per frame
+#define PARTICLE_TRAIL_LIFE 8
+#define PARTICLE_BUDGET_NS 8000000 // render time above which fewer grains are allowed
+#define PARTICLE_MIN_CAP 32
+#define SAND_COLOR 0xC4E8
+#define TRAIL_COLOR 0xFFDB
+void reset_particles(Particles* particles);
+void particles_step(Particles* particles, const GameFrame* frame);
+void draw_particles(Particles* particles);
+void clear_particles(Particles* particles, Dune* dune);
+void particles_budget(Particles* particles, unsigned int renderTime);
+
+// attract mode
+bool autopilot_choose(const World* world);
+
+// helper functions
+bool in_bounds(int x, int y);
+bool in_y_bounds(int y);
+bool in_x_bounds(int x);
+void draw_line(int x0, int y0, int x1, int y1, short int line_color);
+bool isBallTouchingDune(Ball* ball, Dune* dune); 
+void display_score(int score);
+int max(int a, int b);
+int min(int a, int b);
+
+// drawing/buffer function
+void draw(Ball* ball, Dune* dune, Arrow* arrow, int score);
+void draw_ball(Ball* ball);
+void draw_dune(Dune* Dune);
+void draw_dune_slice(Dune* dune, int x1, int x2);
+void draw_arrow(Arrow* arrow);
+void update_arrow(Arrow* arrow, int y);
+void draw_starting_screen(short int color);
+void draw_game_over_screen(Ball* ball, Dune* dune, int points, int frames);
+void plot_pixel(int x, int y, short int line_color);
+void black_screen();
+void draw_background();
+void build_layers();
+void layer_scroll(double currentX, int* offsets);
+void set_layers(double currentX);
+void draw_sky();
+void build_terrain(unsigned int seed, int* points, double* angles, double* heights);
+void terrain_begin(TerrainBuild* build, unsigned int seed, int* points, double* angles, double* heights);
+bool terrain_step(void* arg);
+void terrain_finish(TerrainBuild* build);
+bool glyph_step(void* arg);
+bool hud_step(void* arg);
+void draw_score(int points);
+void draw_2500(int x, int y, short int color);
+void fill_ball(const Ball* ball);
+
+// full screen passes, run once per horizontal band
+void raster_parallel(void (*pass)(void* arg), void* arg);
+
+// clearing functions
+void clear_pixel(int x, int y);
+void clear_line(int x0, int y0, int x1, int y1);
+void clear_rectangle(int x0, int y0, int x1, int y1);
+void clear_screen(Ball* ball, Dune* dune, Arrow* arrow);
+void clear_ball(Ball* ball);
+void clear_arrow(Arrow* arrow);
+void clear_running_dune(Dune* dune);
+void clear_all_dune(Dune* dune);
+
+void wait_for_vsync();
+
+// logging, drained while waiting for vsync
+bool log_printf(const char* format, ...);
+bool log_step(void* arg);
+void log_drain();
+
+// cooperative background tasks, stepped while polling for the buffer swap;
+// a step must be short since the swap is only checked between steps
+int idle_add(const char* name, bool (*step)(void* arg), void* arg, int budget);
+void idle_new_frame();
+bool idle_step();
+bool hex_step(void* arg);
+
+// input to photon latency
+unsigned int trace_ns();
+int latency_begin(unsigned int input);
+void latency_report();
+bool ps2_watch_step(void* arg);
+
+// audio
+void audio_update(const GameFrame* frame);
+void audio_feed();
+bool audio_step(void* arg);
+void audio_report();
+
+// per frame telemetry
+void telemetry_begin();
+void telemetry_record(TelemetryFrame* frame);
+int telemetry_encode(unsigned char* out, const TelemetryFrame* frame, TelemetryDelta* delta);
+int telemetry_decode(const unsigned char* in, TelemetryFrame* frame, TelemetryDelta* delta);
+
+// snapshots used to restart without redrawing
+void save_frame(FrameSnapshot* snap, int buffer);
+void restore_frame(FrameSnapshot* snap);
+void restore_initial_frames();
+
+// device layer: every register access is counted, the outputs keep shadow
+// copies so unchanged writes are skipped, and the switches are cached
+#define SHADOW_LEDR 0
+#define SHADOW_HEX3_HEX0 1
+#define SHADOW_HEX5_HEX4 2
+#define DEVICE_SHADOWS 3
+#define SWITCH_REFRESH 4 // frames between reads of the switches
+void dev_shadow_write(int shadow, int value);
+void device_report();
+
+// mouse functions
+void space_key_clicked(bool* flag);
+void receive_bytes(int n);
+// change color
+int read_SW();
+short int set_ball_color();
+
+// input recording and replay
+void begin_trace();
+void poll_switches();
+void poll_spacebar(bool* spacebar);
+bool game_running();
+int terrain_rand(unsigned int* state);
+#ifdef HOST_BUILD
+void host_init();
+bool load_trace(const char* path);
+bool save_trace(const char* path);
+void frame_presented(int buffer);
+unsigned long long hash_frame(int buffer);
+bool write_ppm(const char* path, int buffer);
+bool capture_output(const char* path);
+void capture_frame(int buffer);
+bool capture_finish();
+void bench_raster(FILE* out);
+void bench_physics(FILE* out, long steps);
+void bench_riders(FILE* out);
+void bench_frames(FILE* out, int frames);
+void run_sweep(FILE* out, int count, int threads, int frames);
+void env_reset(DuneEnv* env, DuneTerrain* terrain, unsigned int seed);
+int env_step(DuneEnv* env, bool spacebar);
+const short int* env_render(const DuneEnv* env);
+DuneBatch* batch_create(int count);
+void batch_free(DuneBatch* batch);
+void batch_reset(DuneBatch* batch, unsigned int seed);
+void batch_step(DuneBatch* batch, const bool* actions, int* rewards);
+void bench_env(FILE* out, long steps);
+bool check_env(FILE* out, unsigned int seed);
+void run_split();
+void gen_tables(FILE* out);
+bool audio_output(const char* path);
+bool audio_finish();
+bool telemetry_output(const char* path);
+bool telemetry_step(void* arg);
+bool telemetry_finish();
+bool telemetry_map(TelemetryReader* reader, const char* path);
+bool telemetry_seek(TelemetryReader* reader, unsigned int frame);
+bool telemetry_next(TelemetryReader* reader, TelemetryFrame* frame);
+void telemetry_unmap(TelemetryReader* reader);
+bool telemetry_dump(FILE* out, const char* path, unsigned int first, unsigned int count);
+void raster_dispatch(void (*pass)(void* arg), void* arg);
+#endif
+
+// frame pipeline: the simulation publishes a GameFrame, the renderer draws it
+void setup_devices();
+void start_game(Game* game);
+void start_renderer(Renderer* renderer, const Ball* ball);
+void prepare_frame(Game* game, GameFrame* frame);
+void advance_game(Game* game);
+void start_run(Game* game, bool autopilot);
+void render_frame(Renderer* renderer, const GameFrame* frame);
+void present_frame(Renderer* renderer);
+GameFrame* queue_reserve(FrameQueue* queue);
+void queue_publish(FrameQueue* queue);
+GameFrame* queue_front(FrameQueue* queue);
+void queue_release(FrameQueue* queue);
+void run_game();
+
+volatile int pixel_buffer_start; // global variable
+unsigned char seven_seg_decode_table[] = {0x3F, 0x06, 0x5B, 0x4F, 0x66, 0x6D, 0x7D, 0x07, 0x7F, 0x67};
+short int ball_colors[] = {WHITE, RED, ORANGE, YELLOW, GREEN, CYAN, BLUE, MAGENTA, PINK, BLACK};
+// variables to clear +2500
+int toClear = 0;
+int toDraw = 0;
+// render time above which the particle cap is halved, 0 to never cap
+unsigned int particle_budget_ns = PARTICLE_BUDGET_NS;
+// both buffers as they look at the start of a game
+FrameSnapshot initial_frames[2];
+// dune history before the dunes are first drawn: flat on the bottom row
+const int flat_dune[RESOLUTION_X] = {[0 ... RESOLUTION_X-1] = RESOLUTION_Y-1};
+// the sky above LAYER_BOTTOM: background and parallax layers pre-rendered as
+// wrap-around strips, shown from layer_offset[0] for clouds, [1] for far dunes
+short int layer_pixels[LAYER_BOTTOM][LAYER_STORE];
+int layer_offset[2];
+bool layers_built = false;
+// x, y and radius of the circles making up the clouds, x within LAYER_PERIOD
+static const short int cloud_puffs[][3] = {
+	{30, 30, 8}, {42, 25, 11}, {56, 29, 8}, {66, 32, 5},
+	{170, 17, 6}, {180, 13, 9}, {192, 16, 6},
+	{300, 36, 7}, {312, 32, 10}, {326, 30, 9}, {339, 35, 6},
+	{420, 21, 5}, {429, 19, 7},
+};
+
+// per frame input log, laid out exactly like the trace file:
+// "DINP", u16 version, u16 reserved, u32 terrain seed, u32 frame count, then
+// one little endian u16 per frame holding the switches and TRACE_SPACEBAR
+// on the board, set input_mode and load or dump input_trace from the debugger
+int input_mode = INPUT_LIVE;
+unsigned char input_trace[TRACE_HEADER_SIZE + 2*MAX_TRACE_FRAMES];
+int trace_frames = 0; // frames recorded, or frames available to replay
+int trace_frame = 0; // next frame to replay
+int frame_switches = 0; // switch state sampled for the current frame
+unsigned int terrain_seed = DEFAULT_TERRAIN_SEED;
+int frames_run = 0;
+int max_frames = 0; // host build stops after this many frames, 0 for no limit
+int attract_delay = ATTRACT_DELAY;
+int final_score = 0;
+
+// spacebar of every frame of the current run, and of the last GHOST_RUNS runs
+unsigned char run_inputs[MAX_TRACE_FRAMES/8];
+unsigned char ghost_runs[GHOST_RUNS][MAX_TRACE_FRAMES/8];
+int ghost_frames[GHOST_RUNS];
+int ghost_count = 0;
+Riders riders;
+
+Game game;
+Renderer renderer;
+FrameQueue frame_queue;
+LogRing log_ring;
+IdleTask idle_tasks[MAX_IDLE_TASKS];
+int idle_task_count = 0;
+int idle_next = 0; // round robin position
+int hex_score = -1; // score waiting to go to the HEX displays, -1 when shown
+int hex_shown = -1; // score on the HEX displays
+Hud hud = {.shown = -1, .previous = -1, .score = -1};
+DeviceStats device_stats;
+int device_shadow[DEVICE_SHADOWS]; // last value written to each output
+bool device_shadow_valid[DEVICE_SHADOWS]; // false until the first write, the reset value is unknown
+static const unsigned int shadow_addr[DEVICE_SHADOWS] = {LEDR_BASE, HEX3_HEX0_BASE, HEX5_HEX4_BASE};
+int switch_cache = 0;
+int switch_age = 0; // frames since the switches were read
+LatencySample latency_samples[LATENCY_SAMPLES];
+unsigned int latency_count = 0; // spacebar changes traced so far
+unsigned int ps2_seen = 0; // when a keyboard byte was first seen since the last poll, 0 for none
+
+// telemetry ring, laid out exactly like the telemetry file:
+// "DTEL", u16 version, u16 chunk size, u32 terrain seed, u32 oldest chunk,
+// then the chunks, each with u32 first frame, u16 frames, u16 bytes used,
+// and the encoded frames; on the board, dump telemetry from the debugger
+unsigned char telemetry[TELEMETRY_HEADER_SIZE + TELEMETRY_CHUNKS*TELEMETRY_CHUNK];
+TelemetryWriter telemetry_writer;
+AudioMixer audio;
+
+#ifdef HOST_BUILD
+// golden frame hashes, one 16 digit hex hash per line
+int golden_mode = GOLDEN_OFF;
+FILE* golden_file = NULL;
+const char* golden_dump_path = "golden_mismatch.ppm";
+int frames_presented = 0; // buffer swaps so far, including the two at startup
+int golden_mismatch = -1; // first frame that did not match
+int golden_end = -1; // last frame of a golden file shorter than the run
+bool stop_requested = false; // set by the renderer to end the run after this frame
+FILE* telemetry_file = NULL; // finished telemetry chunks are written here
+FILE* audio_file = NULL; // WAV file of what the modelled codec played
+FILE* log_file = NULL; // where the log is drained to, stdout if NULL
+#endif
+
+// lookup tables, generated by the host build with ./dune --gen-tables so the
+// board does no trigonometry at startup or on the title screen; regenerate
+// and paste over this block whenever one of the formulas in gen_tables changes
+// BEGIN GENERATED TABLES
+// BACKGROUND + GRADIENT*y / RESOLUTION_Y
+static const short int background_rows[RESOLUTION_Y] = {
+	0x0570, 0x0570, 0x0570, 0x0570, 0x0570, 0x0570, 0x0570, 0x0570,
+	0x0570, 0x0570, 0x0570, 0x0570, 0x0570, 0x0570, 0x0570, 0x0570,
+	0x0571, 0x0571, 0x0571, 0x0571, 0x0571, 0x0571, 0x0571, 0x0571,
+	0x0571, 0x0571, 0x0571, 0x0571, 0x0571, 0x0571, 0x0571, 0x0571,
+	0x0572, 0x0572, 0x0572, 0x0572, 0x0572, 0x0572, 0x0572, 0x0572,
+	0x0572, 0x0572, 0x0572, 0x0572, 0x0572, 0x0572, 0x0572, 0x0572,
+	0x0573, 0x0573, 0x0573, 0x0573, 0x0573, 0x0573, 0x0573, 0x0573,
+	0x0573, 0x0573, 0x0573, 0x0573, 0x0573, 0x0573, 0x0573, 0x0573,
+	0x0574, 0x0574, 0x0574, 0x0574, 0x0574, 0x0574, 0x0574, 0x0574,
+	0x0574, 0x0574, 0x0574, 0x0574, 0x0574, 0x0574, 0x0574, 0x0574,
+	0x0575, 0x0575, 0x0575, 0x0575, 0x0575, 0x0575, 0x0575, 0x0575,
+	0x0575, 0x0575, 0x0575, 0x0575, 0x0575, 0x0575, 0x0575, 0x0575,
+	0x0576, 0x0576, 0x0576, 0x0576, 0x0576, 0x0576, 0x0576, 0x0576,
+	0x0576, 0x0576, 0x0576, 0x0576, 0x0576, 0x0576, 0x0576, 0x0576,
+	0x0577, 0x0577, 0x0577, 0x0577, 0x0577, 0x0577, 0x0577, 0x0577,
+	0x0577, 0x0577, 0x0577, 0x0577, 0x0577, 0x0577, 0x0577, 0x0577,
+	0x0578, 0x0578, 0x0578, 0x0578, 0x0578, 0x0578, 0x0578, 0x0578,
+	0x0578, 0x0578, 0x0578, 0x0578, 0x0578, 0x0578, 0x0578, 0x0578,
+	0x0579, 0x0579, 0x0579, 0x0579, 0x0579, 0x0579, 0x0579, 0x0579,
+	0x0579, 0x0579, 0x0579, 0x0579, 0x0579, 0x0579, 0x0579, 0x0579,
+	0x057A, 0x057A, 0x057A, 0x057A, 0x057A, 0x057A, 0x057A, 0x057A,
+	0x057A, 0x057A, 0x057A, 0x057A, 0x057A, 0x057A, 0x057A, 0x057A,
+	0x057B, 0x057B, 0x057B, 0x057B, 0x057B, 0x057B, 0x057B, 0x057B,
+	0x057B, 0x057B, 0x057B, 0x057B, 0x057B, 0x057B, 0x057B, 0x057B,
+	0x057C, 0x057C, 0x057C, 0x057C, 0x057C, 0x057C, 0x057C, 0x057C,
+	0x057C, 0x057C, 0x057C, 0x057C, 0x057C, 0x057C, 0x057C, 0x057C,
+	0x057D, 0x057D, 0x057D, 0x057D, 0x057D, 0x057D, 0x057D, 0x057D,
+	0x057D, 0x057D, 0x057D, 0x057D, 0x057D, 0x057D, 0x057D, 0x057D,
+	0x057E, 0x057E, 0x057E, 0x057E, 0x057E, 0x057E, 0x057E, 0x057E,
+	0x057E, 0x057E, 0x057E, 0x057E, 0x057E, 0x057E, 0x057E, 0x057E,
+};
+// sin(DUNE_FREQUENCY*x) and cos(DUNE_FREQUENCY*x) over one dune
+static const double dune_sine[DUNE_PERIOD] = {
+	0, 0.039259815759067444, 0.078459095727842612, 0.11753739745783416, 0.15643446504022626, 0.19509032201612253, 0.23344536385589859, 0.27144044986506638,
+	0.30901699437493857, 0.34611705707748314, 0.38268343236507901, 0.41865973753741642, 0.45399049973953431, 0.48862124149694175, 0.52249856471593492, 0.55557023301958763,
+	0.58778525229245804, 0.61909394930981843, 0.64944804833016767, 0.67880074553292546, 0.70710678118653103, 0.7343225094356689, 0.76040596560001428, 0.78531693088072829,
+	0.80901699437493091, 0.83146961230252903, 0.85264016435407641, 0.87249600707278174, 0.89100652418835302, 0.90814317382506715, 0.9238795325112733, 0.93819133592247161,
+	0.95105651629514198, 0.96245523645363684, 0.97236992039766734, 0.98078528040322244, 0.98768834059513111, 0.99306845695492119, 0.99691733373312452, 0.99922903624072112,
+	1, 0.99922903624072479, 0.99691733373313185, 0.99306845695493218, 0.98768834059514576, 0.98078528040324064, 0.97236992039768921, 0.96245523645366216,
+	0.95105651629517085, 0.93819133592250392, 0.92387953251130905, 0.90814317382510612, 0.89100652418839532, 0.87249600707282737, 0.85264016435412526, 0.83146961230258098,
+	0.80901699437498586, 0.78531693088078613, 0.76040596560007478, 0.73432250943573218, 0.7071067811865972, 0.67880074553299419, 0.64944804833023873, 0.61909394930989181,
+	0.58778525229253353, 0.55557023301966524, 0.52249856471601441, 0.48862124149702302, 0.4539904997396173, 0.41865973753750141, 0.38268343236516539, 0.34611705707757079,
+	0.30901699437502733, 0.2714404498651562, 0.2334453638559893, 0.19509032201621396, 0.15643446504031872, 0.11753739745792706, 0.078459095727935815, 0.039259815759160807,
+	9.3381198748427885e-14, -0.039259815758974186, -0.078459095727749631, -0.1175373974577416, -0.15643446504013425, -0.1950903220160308, -0.23344536385580769, -0.27144044986497645,
+	-0.30901699437484975, -0.34611705707739554, -0.3826834323649928, -0.41865973753733177, -0.45399049973945094, -0.48862124149686009, -0.52249856471585521, -0.55557023301951003,
+	-0.58778525229238243, -0.61909394930974515, -0.64944804833009673, -0.67880074553285696, -0.70710678118646519, -0.7343225094356054, -0.76040596559995388, -0.78531693088067045,
+	-0.80901699437487629, -0.83146961230247718, -0.85264016435402745, -0.87249600707273611, -0.8910065241883105, -0.90814317382502818, -0.92387953251123756, -0.93819133592243942,
+	-0.95105651629511312, -0.96245523645361142, -0.97236992039764558, -0.98078528040320423, -0.98768834059511657, -0.99306845695491019, -0.99691733373311719, -0.99922903624071746,
+	-1, -0.99922903624072845, -0.99691733373313918, -0.99306845695494317, -0.98768834059516042, -0.98078528040325885, -0.97236992039771097, -0.96245523645368747,
+	-0.95105651629519972, -0.93819133592253634, -0.9238795325113448, -0.90814317382514542, -0.89100652418843773, -0.872496007072873, -0.85264016435417378, -0.83146961230263283,
+	-0.80901699437504049, -0.78531693088084387, -0.76040596560013574, -0.73432250943579558, -0.70710678118666326, -0.67880074553306236, -0.64944804833030978, -0.61909394930996475,
+	-0.58778525229260914, -0.55557023301974329, -0.52249856471609413, -0.4886212414971049, -0.45399049973970051, -0.41865973753758617, -0.38268343236525121, -0.34611705707765839,
+	-0.30901699437511659, -0.27144044986524607, -0.23344536385608053, -0.19509032201630555, -0.15643446504041095, -0.11753739745801936, -0.078459095728028921, -0.03925981575925367,
+};
+static const double dune_cosine[DUNE_PERIOD] = {
+	1, 0.99922903624072301, 0.99691733373312819, 0.99306845695492674, 0.98768834059513844, 0.98078528040323154, 0.97236992039767822, 0.9624552364536495,
+	0.95105651629515642, 0.93819133592248782, 0.92387953251129118, 0.90814317382508669, 0.89100652418837423, 0.8724960070728045, 0.85264016435410073, 0.83146961230255501,
+	0.80901699437495844, 0.78531693088075716, 0.76040596560004459, 0.73432250943570065, 0.707106781186564, 0.67880074553295966, 0.6494480483302032, 0.61909394930985506,
+	0.58778525229249579, 0.55557023301962649, 0.52249856471597467, 0.48862124149698249, 0.45399049973957589, 0.41865973753745878, 0.3826834323651222, 0.34611705707752699,
+	0.30901699437498292, 0.27144044986511129, 0.23344536385594389, 0.19509032201616838, 0.15643446504027236, 0.11753739745788049, 0.078459095727889269, 0.03925981575911415,
+	4.6690599374213942e-14, -0.039259815759020843, -0.078459095727796177, -0.11753739745778774, -0.15643446504018013, -0.19509032201607682, -0.2334453638558531, -0.27144044986502142,
+	-0.30901699437489416, -0.34611705707743939, -0.38268343236503594, -0.41865973753737418, -0.4539904997394929, -0.48862124149690084, -0.52249856471589506, -0.55557023301954878,
+	-0.58778525229242029, -0.61909394930978179, -0.64944804833013225, -0.67880074553289127, -0.70710678118649783, -0.73432250943563704, -0.76040596559998386, -0.78531693088069932,
+	-0.80901699437490349, -0.83146961230250316, -0.85264016435405199, -0.87249600707275898, -0.89100652418833193, -0.9081431738250475, -0.92387953251125543, -0.9381913359224554,
+	-0.95105651629512755, -0.96245523645362419, -0.97236992039765646, -0.98078528040321344, -0.98768834059512378, -0.99306845695491575, -0.99691733373312086, -0.99922903624071935,
+	-1, -0.99922903624072668, -0.99691733373313551, -0.99306845695493762, -0.98768834059515298, -0.98078528040324986, -0.97236992039770009, -0.96245523645367492,
+	-0.95105651629518528, -0.93819133592252002, -0.92387953251132693, -0.90814317382512566, -0.89100652418841675, -0.87249600707285024, -0.85264016435414958, -0.83146961230260685,
+	-0.80901699437501329, -0.785316930880815, -0.7604059656001052, -0.73432250943576383, -0.70710678118662995, -0.67880074553302838, -0.64944804833027392, -0.61909394930992845,
+	-0.58778525229257095, -0.5555702330197041, -0.5224985647160546, -0.48862124149706376, -0.45399049973965933, -0.41865973753754337, -0.38268343236520852, -0.34611705707761414,
+	-0.30901699437507174, -0.27144044986520155, -0.2334453638560347, -0.1950903220162602, -0.15643446504036437, -0.11753739745797344, -0.078459095727981931, -0.039259815759207464,
+	-1.405158873324919e-13, 0.039259815758927535, 0.078459095727702641, 0.11753739745769523, 0.15643446504008768, 0.19509032201598545, 0.23344536385576228, 0.27144044986493193,
+	0.30901699437480534, 0.34611705707735135, 0.38268343236494967, 0.41865973753728897, 0.45399049973940969, 0.48862124149681935, 0.52249856471581579, 0.55557023301947117,
+	0.58778525229234502, 0.6190939493097084, 0.64944804833006087, 0.67880074553282277, 0.70710678118643178, 0.73432250943557398, 0.76040596559992324, 0.78531693088064181,
+	0.80901699437484864, 0.83146961230245098, 0.85264016435400325, 0.87249600707271313, 0.89100652418828952, 0.90814317382500842, 0.9238795325112199, 0.9381913359224231,
+	0.95105651629509858, 0.96245523645359887, 0.97236992039763459, 0.98078528040319524, 0.98768834059510924, 0.99306845695490475, 0.99691733373311353, 0.99922903624071568,
+};
+// title screen dune, amplitude 20 for the first dune and 10 after
+static const int title_dune_points[RESOLUTION_X] = {
+	200, 200, 201, 202, 203, 203, 204, 205,
+	206, 206, 207, 208, 209, 209, 210, 211,
+	211, 212, 212, 213, 214, 214, 215, 215,
+	216, 216, 217, 217, 217, 218, 218, 218,
+	219, 219, 219, 219, 219, 219, 219, 219,
+	220, 219, 219, 219, 219, 219, 219, 219,
+	219, 218, 218, 218, 217, 217, 217, 216,
+	216, 215, 215, 214, 214, 213, 212, 212,
+	211, 211, 210, 209, 209, 208, 207, 206,
+	206, 205, 204, 203, 203, 202, 201, 200,
+	200, 199, 198, 197, 196, 196, 195, 194,
+	193, 193, 192, 191, 190, 190, 189, 188,
+	188, 187, 187, 186, 185, 185, 184, 184,
+	183, 183, 182, 182, 182, 181, 181, 181,
+	180, 180, 180, 180, 180, 180, 180, 180,
+	180, 180, 180, 180, 180, 180, 180, 180,
+	180, 181, 181, 181, 182, 182, 182, 183,
+	183, 184, 184, 185, 185, 186, 187, 187,
+	188, 188, 189, 190, 190, 191, 192, 193,
+	193, 194, 195, 196, 196, 197, 198, 199,
+	199, 200, 200, 201, 201, 201, 202, 202,
+	203, 203, 203, 204, 204, 204, 205, 205,
+	205, 206, 206, 206, 207, 207, 207, 207,
+	208, 208, 208, 208, 208, 209, 209, 209,
+	209, 209, 209, 209, 209, 209, 209, 209,
+	210, 209, 209, 209, 209, 209, 209, 209,
+	209, 209, 209, 209, 208, 208, 208, 208,
+	208, 207, 207, 207, 207, 206, 206, 206,
+	205, 205, 205, 204, 204, 204, 203, 203,
+	203, 202, 202, 201, 201, 201, 200, 200,
+	200, 199, 199, 198, 198, 198, 197, 197,
+	196, 196, 196, 195, 195, 195, 194, 194,
+	194, 193, 193, 193, 192, 192, 192, 192,
+	191, 191, 191, 191, 191, 190, 190, 190,
+	190, 190, 190, 190, 190, 190, 190, 190,
+	190, 190, 190, 190, 190, 190, 190, 190,
+	190, 190, 190, 190, 191, 191, 191, 191,
+	191, 192, 192, 192, 192, 193, 193, 193,
+	194, 194, 194, 195, 195, 195, 196, 196,
+	196, 197, 197, 198, 198, 198, 199, 199,
+};
+static const double title_dune_angles[RESOLUTION_X] = {
+	0.66577375002833938, 0.66539913794732763, 0.66427455778575717, 0.66239778177177144, 0.65976511040253683, 0.65637139322014393, 0.65221005910469931, 0.64727315730427848,
+	0.64155141078629552, 0.63503428386853022, 0.6277100664682832, 0.61956597768974109, 0.61058829184366026, 0.60076249034617113, 0.59007344325517264, 0.57850562444664633,
+	0.56604336457424953, 0.55267114594951527, 0.53837394327298715, 0.52313761367531175, 0.50694933872042935, 0.48979811980455051, 0.47167532667943957, 0.45257529657079881,
+	0.43249597850741989, 0.41143961401560541, 0.38941344131158989, 0.36643040566109603, 0.34250985387991628, 0.31767818633681288, 0.2919694357109579, 0.26542573866455554,
+	0.23809766508953226, 0.21004437024737072, 0.1813335384339344, 0.15204109307907271, 0.12225065747093236, 0.092052762260053225, 0.061543809840105566, 0.030824820545115986,
+	3.6670710996432589e-14, -0.030824820545042774, -0.061543809840032736, -0.092052762259981005, -0.12225065747086099, -0.15204109307900243, -0.1813335384338654, -0.21004437024730319,
+	-0.23809766508946642, -0.26542573866449154, -0.29196943571089579, -0.31767818633675288, -0.34250985387985844, -0.36643040566104007, -0.38941344131153638, -0.41143961401555412,
+	-0.43249597850737104, -0.45257529657075224, -0.47167532667939532, -0.48979811980450866, -0.50694933872038972, -0.52313761367527423, -0.53837394327295196, -0.55267114594948241,
+	-0.56604336457421878, -0.57850562444661779, -0.59007344325514621, -0.60076249034614682, -0.61058829184363794, -0.61956597768972077, -0.62771006646826477, -0.63503428386851368,
+	-0.64155141078628097, -0.64727315730426582, -0.65221005910468843, -0.65637139322013494, -0.65976511040252961, -0.662397781771766, -0.66427455778575362, -0.66539913794732586,
+	-0.66577375002833938, -0.66539913794732941, -0.66427455778576072, -0.66239778177177666, -0.65976511040254404, -0.65637139322015292, -0.65221005910471008, -0.64727315730429125,
+	-0.64155141078631006, -0.63503428386854655, -0.62771006646830152, -0.6195659776897614, -0.61058829184368268, -0.60076249034619567, -0.59007344325519917, -0.57850562444667486,
+	-0.56604336457428017, -0.55267114594954825, -0.53837394327302235, -0.52313761367534894, -0.50694933872046899, -0.48979811980459254, -0.47167532667948359, -0.45257529657084539,
+	-0.43249597850746857, -0.41143961401565665, -0.38941344131164363, -0.36643040566115159, -0.3425098538799744, -0.31767818633687284, -0.29196943571102008, -0.26542573866461933,
+	-0.23809766508959812, -0.21004437024743855, -0.18133353843400341, -0.15204109307914315, -0.12225065747100354, -0.092052762260125612, -0.061543809840178071, -0.030824820545189206,
+	-1.1036091983909864e-13, 0.030824820544969558, 0.061543809839959544, 0.092052762259908952, 0.12225065747078946, 0.15204109307893232, 0.1813335384337964, 0.21004437024723599,
+	0.23809766508940053, 0.26542573866442709, 0.29196943571083367, 0.31767818633669254, 0.34250985387980049, 0.36643040566098428, 0.38941344131148309, 0.41143961401550294,
+	0.4324959785073223, 0.45257529657070567, 0.4716753266793508, 0.4897981198044668, 0.50694933872035008, 0.52313761367523703, 0.53837394327291699, 0.55267114594944966,
+	0.56604336457418802, 0.57850562444658904, 0.59007344325511979, 0.60076249034612228, 0.61058829184361563, 0.61956597768970045, 0.62771006646824645, 0.63503428386849725,
+	0.64155141078626643, 0.64727315730425328, 0.65221005910467755, 0.65637139322012594, 0.6597651104025225, 0.66239778177176067, 0.66427455778575006, 0.66539913794732408,
+	0.66577375002833938, 0.37393434761199607, 0.37314742963097114, 0.37183617187149592, 0.37000099327397468, 0.36764250157623241, 0.36476151445533267, 0.36135908658926791,
+	0.35743654253560092, 0.35299551528767631, 0.34803799032471872, 0.34256635491893089, 0.33658345239970555, 0.33009264100168628, 0.32309785683940434, 0.31560368045675502,
+	0.30761540629536516, 0.29913911431322548, 0.29018174286581039, 0.2807511618389979, 0.27085624489996563, 0.26050693961321253, 0.24971433405903193, 0.23849071849697909,
+	0.22684964054343007, 0.21480595228693927, 0.20237584775439568, 0.18957688917132401, 0.17642802053662934, 0.1629495671599227, 0.14916321999094495, 0.13509200380586733,
+	0.12076022860234017, 0.10619342388904399, 0.091418255928370135, 0.076462428391927503, 0.061354567304622798, 0.046124091568835776, 0.030801070759134509, 0.015416072243227512,
+	9.1502384066181052e-14, -0.015416072243044344, -0.030801070758951887, -0.046124091568654081, -0.061354567304442727, -0.07646242839174873, -0.091418255928193332, -0.10619342388886917,
+	-0.12076022860216866, -0.1350920038056988, -0.14916321999077931, -0.16294956715976058, -0.17642802053647069, -0.18957688917117002, -0.20237584775424564, -0.21480595228679375,
+	-0.22684964054328896, -0.23849071849684286, -0.24971433405890126, -0.2605069396130868, -0.27085624489984528, -0.28075116183888277, -0.29018174286570131, -0.29913911431312185,
+	-0.30761540629526729, -0.31560368045666293, -0.32309785683931808, -0.33009264100160624, -0.33658345239963139, -0.34256635491886278, -0.34803799032465665, -0.35299551528762058,
+	-0.35743654253555129, -0.36135908658922433, -0.36476151445529531, -0.36764250157620121, -0.37000099327394981, -0.37183617187147722, -0.37314742963095865, -0.37393434761198979,
+	-0.37419668052267485, -0.37393434761199734, -0.37314742963097364, -0.37183617187149964, -0.37000099327397973, -0.36764250157623857, -0.36476151445534016, -0.36135908658927662,
+	-0.35743654253561091, -0.35299551528768758, -0.34803799032473104, -0.34256635491894449, -0.33658345239972037, -0.33009264100170244, -0.32309785683942144, -0.31560368045677339,
+	-0.30761540629538475, -0.2991391143132463, -0.29018174286583243, -0.28075116183902071, -0.27085624489998972, -0.26050693961323768, -0.2497143340590583, -0.23849071849700601,
+	-0.22684964054345796, -0.21480595228696839, -0.20237584775442569, -0.18957688917135518, -0.17642802053666068, -0.16294956715995512, -0.14916321999097809, -0.13509200380590147,
+	-0.12076022860237423, -0.10619342388907854, -0.091418255928405509, -0.076462428391963252, -0.061354567304659227, -0.046124091568871768, -0.030801070759171028, -0.015416072243264144,
+	-1.285218819124145e-13, 0.01541607224300736, 0.030801070758915715, 0.046124091568617742, 0.061354567304406298, 0.076462428391712634, 0.091418255928158304, 0.1061934238888346,
+	0.12076022860213396, 0.13509200380566466, 0.14916321999074586, 0.16294956715972844, 0.17642802053643933, 0.18957688917113888, 0.20237584775421535, 0.21480595228676494,
+	0.22684964054326107, 0.23849071849681588, 0.24971433405887483, 0.26050693961306137, 0.27085624489982141, 0.28075116183886006, 0.29018174286567916, 0.29913911431310097,
+	0.30761540629524747, 0.31560368045664466, 0.32309785683930098, 0.33009264100159003, 0.33658345239961646, 0.34256635491884929, 0.34803799032464439, 0.35299551528760925,
+	0.35743654253554119, 0.36135908658921556, 0.36476151445528793, 0.36764250157619505, 0.37000099327394481, 0.37183617187147344, 0.37314742963095615, 0.37393434761198857,
+};
+// half widths of the D in the logo, sqrt(42*42 - y*y) and sqrt(28*28 - y*y)
+static const unsigned char logo_outer_span[43] = {
+	42, 41, 41, 41, 41, 41, 41, 41,
+	41, 41, 40, 40, 40, 39, 39, 39,
+	38, 38, 37, 37, 36, 36, 35, 35,
+	34, 33, 32, 32, 31, 30, 29, 28,
+	27, 25, 24, 23, 21, 19, 17, 15,
+	12, 9, 0,
+};
+static const unsigned char logo_inner_span[29] = {
+	28, 27, 27, 27, 27, 27, 27, 27,
+	26, 26, 26, 25, 25, 24, 24, 23,
+	22, 22, 21, 20, 19, 18, 17, 15,
+	14, 12, 10, 7, 0,
+};
+// END GENERATED TABLES
+
+// counted device register access; addr is the register's bus address
+static inline int dev_read(unsigned int addr){
+	__atomic_fetch_add(&device_stats.reads, 1, __ATOMIC_RELAXED);
+	return *IO(addr);
+}
+
+static inline void dev_write(unsigned int addr, int value){
+	__atomic_fetch_add(&device_stats.writes, 1, __ATOMIC_RELAXED);
+	*IO(addr) = value;
+}
+
+// raster-op line and span engine
+// each raster operation writes one pixel; DEFINE_LINE_ENGINE stamps out a
+// vertical span, horizontal span and Bresenham line for it so the per pixel
+// work is inlined instead of going through plot_pixel/clear_pixel
+#define PIXEL_ADDR(x, y) ((short int *)(BUS(pixel_buffer_start) + ((y) << 10) + ((x) << 1)))
+// what a pixel holds with nothing drawn over it: the sky strips above LAYER_BOTTOM, the gradient below
+#define LAYER_AT(x, y) (layer_pixels[y][(x) + layer_offset[(y) >= CLOUD_BOTTOM]])
+#define BACKGROUND_AT(x, y) (((y) < LAYER_BOTTOM) ? LAYER_AT(x, y) : background_rows[y])
+
+#define ROP_SOLID(x, y, c) (*PIXEL_ADDR(x, y) = (c))
+#define ROP_RESTORE(x, y, c) ((void) (c), *PIXEL_ADDR(x, y) = BACKGROUND_AT(x, y))
+// background, or dune below terrain_under[x]; what a buffer held before its sprites were drawn
+#define ROP_TERRAIN(x, y, c) ((void) (c), *PIXEL_ADDR(x, y) = ((y) >= terrain_under[x]) ? DUNE_COLOR : BACKGROUND_AT(x, y))
+#define ROP_GLYPH(x, y, c) ((void) (c), glyph_record[y] |= 1 << (x))
+
+// rows [band_top, band_bottom) this thread may write; the whole screen
+// except while a band-parallel pass runs, where each thread gets its own band
+#ifdef HOST_BUILD
+#define BAND_LOCAL __thread
+#else
+#define BAND_LOCAL
+#endif
+BAND_LOCAL int band_top = 0;
+BAND_LOCAL int band_bottom = RESOLUTION_Y;
+BAND_LOCAL bool in_band_pass = false;
+#define IN_BAND(y) ((unsigned int) ((y) - band_top) < (unsigned int) (band_bottom - band_top))
+int raster_threads = 1; // bands per full screen pass, only the host starts more than one
+
+// dune heights used by the terrain raster op
+const int* terrain_under;
+// glyph mask that draw_line records into instead of drawing, while glyph_step caches one
+unsigned char* glyph_record;
+
+#define DEFINE_LINE_ENGINE(name, ROP) \
+static inline void name##_vertical(int x0, int y0, int y1, short int color){ \
+	if (y0 > y1){ \
+		int temp = y0; \
+		y0 = y1; \
+		y1 = temp; \
+	} \
+	y0 = (y0 < band_top) ? band_top : y0; \
+	y1 = (y1 >= band_bottom) ? band_bottom-1 : y1; \
+	for (int y = y0; y <= y1; y++) ROP(x0, y, color); \
+} \
+static inline void name##_horizontal(int x0, int x1, int y0, short int color){ \
+	if (!IN_BAND(y0)) return; \
+	if (x0 > x1){ \
+		int temp = x0; \
+		x0 = x1; \
+		x1 = temp; \
+	} \
+	for (int x = x0; x <= x1; x++) ROP(x, y0, color); \
+} \
+static inline void name##_line(int x0, int y0, int x1, int y1, short int color){ \
+	if (x0 == x1){ \
+		name##_vertical(x0, y0, y1, color); \
+		return; \
+	} \
+	if (y0 == y1){ \
+		name##_horizontal(x0, x1, y0, color); \
+		return; \
+	} \
+	int is_steep = ABS(y1-y0) > ABS(x1-x0); \
+	if (is_steep){ /* swap the variable around if the line is steep */ \
+		int temp = y0; \
+		y0 = x0; \
+		x0 = temp; \
+		temp = y1; \
+		y1 = x1; \
+		x1 = temp; \
+	} \
+	if (x0 > x1){ /* draw from smallest to biggest for simplicity */ \
+		int temp = x1; \
+		x1 = x0; \
+		x0 = temp; \
+		temp = y1; \
+		y1 = y0; \
+		y0 = temp; \
+	} \
+	int deltaX = x1 - x0; \
+	int deltaY = ABS(y1 - y0); \
+	int error = -(deltaX/2); \
+	int y = y0; \
+	int y_step = (y0 < y1) ? 1 : -1; \
+	/* band in locals so the pixel stores cannot force a reload */ \
+	int top = band_top; \
+	unsigned int rows = band_bottom - band_top; \
+	/* separate loops so the steep test is not done per pixel */ \
+	if (is_steep){ \
+		for (int x = x0; x <= x1; x++){ \
+			if ((unsigned int) (x - top) < rows) ROP(y, x, color); \
+			error += deltaY; \
+			if (error >= 0){ \
+				y += y_step; \
+				error -= deltaX; \
+			} \
+		} \
+	} \
+	else{ \
+		for (int x = x0; x <= x1; x++){ \
+			if ((unsigned int) (y - top) < rows) ROP(x, y, color); \
+			error += deltaY; \
+			if (error >= 0){ \
+				y += y_step; \
+				error -= deltaX; \
+			} \
+		} \
+	} \
+}
+
+DEFINE_LINE_ENGINE(solid, ROP_SOLID)     // solid_line, solid_vertical, solid_horizontal
+DEFINE_LINE_ENGINE(restore, ROP_RESTORE) // restore_line, ... (colour ignored)
+DEFINE_LINE_ENGINE(terrain, ROP_TERRAIN) // terrain_line, ... (colour ignored)
+DEFINE_LINE_ENGINE(glyph, ROP_GLYPH)     // glyph_line, ... into glyph_record (colour ignored)
+
+// bands never overlap, so the pixel writes need no locking; a pass must not
+// change game state since it runs once per band
+void raster_parallel(void (*pass)(void* arg), void* arg){
+#ifdef HOST_BUILD
+	if (!in_band_pass && raster_threads > 1){
+		raster_dispatch(pass, arg);
+		return;
+	}
+#endif
+	pass(arg);
+}
+
+// reset the keyboard, clear both pixel buffers and start the idle tasks
+void setup_devices(){
+	// background work done while waiting for each swap
+	idle_add("log", log_step, NULL, LOG_SLOTS);
+	idle_add("hex", hex_step, NULL, 1);
+	idle_add("ps2", ps2_watch_step, NULL, 1);
+	idle_add("audio", audio_step, NULL, AUDIO_BLOCKS + AUDIO_FEEDS);
+	idle_add("terrain", terrain_step, &game.terrain, 4);
+	idle_add("glyphs", glyph_step, &hud, 1);
+	idle_add("hud", hud_step, &hud, 1);
+#ifdef HOST_BUILD
+	idle_add("telemetry", telemetry_step, NULL, 4);
+#endif
+#ifndef HOST_BUILD
+	// free running clock for trace_ns
+	dev_write(MPCORE_PRIV_TIMER, 0xFFFFFFFF); // load value
+	dev_write(MPCORE_PRIV_TIMER + 8, 3); // enable, auto reload
+#endif
+	
+	// set up ps2 port
+	dev_write(PS2_BASE, 0xFF); // reset keyboard
+	receive_bytes(2); // receive acknowledge bits
+	dev_write(PS2_BASE + 4, 1); // RE, so the RI bit shows unread bytes to ps2_watch_step
+	
+	// empty the codec FIFOs
+	dev_write(AUDIO_BASE, 0xC); // CR and CW
+	dev_write(AUDIO_BASE, 0);
+	
+	// set up buffers
+	/* set front pixel buffer to start of FPGA On-chip memory */
+    dev_write(PIXEL_BUF_CTRL_BASE + 4, FPGA_ONCHIP_BASE); // first store the address in the back buffer
+    /* now, swap the front/back buffers, to set the front buffer location */
+    wait_for_vsync();
+    /* initialize a pointer to the pixel buffer, used by drawing functions */
+    pixel_buffer_start = dev_read(PIXEL_BUF_CTRL_BASE);
+	// clear the buffer at 0xc8000000 (back buffer)
+	build_layers();
+	draw_background();
+	
+    /* set back pixel buffer to start of SDRAM memory */
+    dev_write(PIXEL_BUF_CTRL_BASE + 4, SDRAM_BASE);
+	pixel_buffer_start = dev_read(PIXEL_BUF_CTRL_BASE + 4); // we draw on the back buffer
+	// clear the back buffer
+	draw_background();
+	wait_for_vsync();
+	// keep the cleared buffers for the title to game transition and restarts
+	save_frame(&initial_frames[0], FPGA_ONCHIP_BASE);
+	save_frame(&initial_frames[1], SDRAM_BASE);
+}
+
+// build the terrain and put the game on the title screen
+void start_game(Game* game){
+	//parameters for the dunes
+	// the seed comes from the input trace when replaying
+	begin_trace();
+	telemetry_begin();
+	// the columns are built in idle time while the title shows
+	terrain_begin(&game->terrain, terrain_seed, game->points, game->angles, game->heights);
+	
+	// ball, dunes and scroll position
+	reset_world(&game->world, game->points, game->angles, game->heights);
+	// initial game state, restored on restart
+	game->initialWorld = game->world;
+	
+	game->mode = MODE_TITLE;
+	game->score = 0;
+	game->gameOverFrames = 0;
+	game->runFrames = 0;
+	game->spacebar = false;
+	game->restore = false;
+	game->bonus = false;
+	game->latency = -1;
+	game->stepFlags = 0;
+	game->stepTime = 0;
+	game->titleFrames = 0;
+	game->autopilot = false;
+}
+
+void start_renderer(Renderer* renderer, const Ball* ball){
+	Arrow arrow = {.x = BALL_X, .y = 5, .h = MIN_ARROW_HEIGHT, .h1 = MIN_ARROW_HEIGHT, .h2 = MIN_ARROW_HEIGHT, .color = WHITE};
+	renderer->arrow = arrow;
+	renderer->ball = *ball;
+	renderer->riders.count = 0;
+	reset_particles(&renderer->particles);
+	renderer->latency = -1;
+	toDraw = 0;
+	toClear = 0;
+}
+
+// first half of a simulated frame: sample the switches, score the frame and
+// publish everything it draws
+void prepare_frame(Game* game, GameFrame* frame){
+	World* world = &game->world;
+	poll_switches();
+	// check for ball color
+	world->ball.color = set_ball_color();
+	
+	frame->mode = game->mode;
+	frame->restore = game->restore;
+	frame->bonus = false;
+	frame->latency = game->latency;
+	game->latency = -1;
+	frame->stepFlags = game->stepFlags;
+	frame->stepTime = game->stepTime;
+	frame->input = (frame_switches & 0x3FF) | (game->spacebar ? TRACE_SPACEBAR : 0);
+	frame->gameOverFrames = game->gameOverFrames;
+	game->restore = false;
+	if(game->mode == MODE_GAME_OVER) game->gameOverFrames++;
+	else if(game->mode == MODE_PLAY){
+		// check for +2500 score bonus
+		frame->bonus = game->bonus;
+		game->score = add_score(game->score, world->ball.dx, game->bonus);
+		game->bonus = false;
+	}
+	frame->score = game->score;
+	frame->ball = world->ball;
+	frame->dune = world->dune;
+	frame->currentX = world->currentX;
+	
+	int n = riders.count;
+	frame->riderCount = n;
+	memcpy(frame->riderScroll, riders.scroll, n*sizeof(riders.scroll[0]));
+	memcpy(frame->riderY, riders.y, n*sizeof(riders.y[0]));
+	memcpy(frame->riderAlive, riders.alive, n*sizeof(riders.alive[0]));
+}
+
+// second half: read the spacebar, step the physics and change modes; the
+// result shows up in the next published frame
+void advance_game(Game* game){
+	World* world = &game->world;
+	unsigned int polled = trace_ns();
+	bool held = game->spacebar;
+	poll_spacebar(&game->spacebar);
+	bool spacebar = game->spacebar;
+	
+	//update drawing
+	int prevY = world->ball.y;
+	double prevDy = world->ball.dy;
+	bool isGameOver = false;
+	int lastFlags = game->stepFlags;
+	game->stepFlags = 0;
+	if(game->mode == MODE_PLAY){
+		bool input = game->autopilot ? autopilot_choose(world) : spacebar;
+		game->stepFlags = physics_step(world, input);
+		// coming down hard after a step in the air throws up sand
+		if((game->stepFlags & STEP_CONTACT) && !(lastFlags & STEP_CONTACT) && prevDy > PARTICLE_LANDING_DY)
+			game->stepFlags |= STEP_LANDED;
+		if(game->stepFlags & STEP_CRASH) isGameOver = true;
+		record_run_input(game->runFrames, input);
+		ghost_inputs(&riders, game->runFrames);
+		riders_step(&riders, world);
+		game->runFrames++;
+	}
+	
+	// a press or release changes the acceleration from this step on
+	unsigned int seen = __atomic_exchange_n(&ps2_seen, 0, __ATOMIC_RELAXED);
+	if (spacebar != held) game->latency = latency_begin(seen ? seen : polled);
+
+	// draw +2500
+	if (prevY > SCORE_LINE_Y && world->ball.y < SCORE_LINE_Y)
+		game->bonus = true;
+	
+	//start the game after pressing space of the start screen
+	if(game->mode == MODE_TITLE){
+		if(spacebar) start_run(game, false);
+		else if(++game->titleFrames >= attract_delay) start_run(game, true);
+	}
+	else if(game->mode == MODE_PLAY){
+		// the player takes over from the autopilot with a run of their own
+		if(game->autopilot && spacebar) start_run(game, false);
+	}
+	else if(game->mode == MODE_GAME_OVER){ //reset values
+		if(spacebar && game->gameOverFrames >= 3) start_run(game, false);
+		else if(game->autopilot && game->gameOverFrames >= ATTRACT_RESTART) start_run(game, true);
+	}
+	
+	final_score = game->score;
+	if (game->score >= 999999 || isGameOver){
+		if (game->mode != MODE_GAME_OVER && game->autopilot)
+			log_printf("autopilot run over: score %d after %d frames\n", game->score, game->runFrames);
+		else if (game->mode != MODE_GAME_OVER){
+			save_ghost(game->runFrames);
+			log_printf("run over: score %d after %d frames\n", game->score, game->runFrames);
+#ifndef HOST_BUILD
+			latency_report();
+			audio_report();
+			device_report();
+#endif
+		}
+		game->mode = MODE_GAME_OVER;
+	}
+	game->stepTime = trace_ns() - polled;
+}
+
+// a run from the start of the terrain; the player's runs race the ghosts of
+// their last ones, the autopilot's are not kept as ghosts
+void start_run(Game* game, bool autopilot){
+	World* world = &game->world;
+	terrain_finish(&game->terrain); // space may come before idle time has built it all
+	game->mode = MODE_PLAY;
+	game->gameOverFrames = 0;
+	game->bonus = false;
+	game->restore = true;
+	int color = world->ball.color;
+	*world = game->initialWorld;
+	world->ball.color = color;
+	game->score = 0;
+	game->runFrames = 0;
+	game->autopilot = autopilot;
+	if(autopilot) reset_riders(&riders, 0);
+	else spawn_ghosts(&riders);
+}
+
+// clear and draw one published frame into the back buffer; only reads the
+// frame, what was drawn is remembered in the renderer for erasing it later
+void render_frame(Renderer* renderer, const GameFrame* frame){
+	unsigned int started = trace_ns();
+	audio_update(frame);
+	audio_feed();
+	Riders* drawn = &renderer->riders;
+	if(frame->restore){
+		// start of a run: both buffers go back to the cleared background
+		restore_initial_frames();
+		renderer->ball = frame->ball;
+		reset_riders(drawn, frame->riderCount);
+		reset_particles(&renderer->particles);
+		toDraw = 0; // set variables to clear +2500
+		toClear = 2;
+	}
+	renderer->ball.x = frame->ball.x;
+	renderer->ball.y = frame->ball.y;
+	renderer->ball.color = frame->ball.color;
+	drawn->count = frame->riderCount;
+	memcpy(drawn->scroll, frame->riderScroll, drawn->count*sizeof(drawn->scroll[0]));
+	memcpy(drawn->y, frame->riderY, drawn->count*sizeof(drawn->y[0]));
+	memcpy(drawn->alive, frame->riderAlive, drawn->count*sizeof(drawn->alive[0]));
+	// windows into the terrain store, nothing is copied
+	Dune view = frame->dune;
+	Dune* dune = &view;
+	
+	/* Erase any game things that were drawn in the last iteration */
+	if(frame->mode == MODE_PLAY){
+		set_layers(frame->currentX);
+		clear_screen(&renderer->ball, dune, &renderer->arrow);
+		clear_riders(drawn, dune);
+		clear_particles(&renderer->particles, dune);
+		clear_running_dune(dune);
+		draw_sky();
+		audio_feed();
+	}
+	
+	// code for drawing the current game iteration
+	if(frame->mode == MODE_TITLE) draw_starting_screen(frame->ball.color);
+	else if(frame->mode == MODE_GAME_OVER)
+		draw_game_over_screen(&renderer->ball, dune, frame->score, frame->gameOverFrames);
+	else{
+		if(frame->bonus) toDraw = FRAMES_2500;
+		particles_step(&renderer->particles, frame);
+		draw_riders(drawn, frame->currentX);
+		draw_particles(&renderer->particles);
+		audio_feed();
+		draw(&renderer->ball, dune, &renderer->arrow, frame->score);
+	}
+	display_score(frame->score);
+	audio_feed();
+	
+	unsigned int rendered = trace_ns();
+	if(frame->mode == MODE_PLAY) particles_budget(&renderer->particles, rendered - started);
+	if(frame->latency >= 0) latency_samples[frame->latency].render = rendered;
+	renderer->latency = frame->latency;
+	
+	TelemetryFrame* telemetry = &renderer->telemetry;
+	telemetry->mode = frame->mode;
+	telemetry->flags = frame->stepFlags;
+	telemetry->value[TELEMETRY_X] = frame->ball.x;
+	telemetry->value[TELEMETRY_Y] = frame->ball.y;
+	telemetry->value[TELEMETRY_DX] = (int) (frame->ball.dx*TELEMETRY_FIXED);
+	telemetry->value[TELEMETRY_DY] = (int) (frame->ball.dy*TELEMETRY_FIXED);
+	telemetry->value[TELEMETRY_SCROLL] = (int) (frame->currentX*TELEMETRY_FIXED);
+	telemetry->value[TELEMETRY_SCORE] = frame->score;
+	telemetry->value[TELEMETRY_INPUT] = frame->input;
+	telemetry->value[TELEMETRY_STEP] = frame->stepTime/1000;
+	telemetry->value[TELEMETRY_RENDER] = (rendered - started)/1000;
+}
+
+void present_frame(Renderer* renderer){
+	unsigned int waited = trace_ns();
+	wait_for_vsync(); // swap front and back buffers on VGA vertical sync
+	pixel_buffer_start = dev_read(PIXEL_BUF_CTRL_BASE + 4); // new back buffer
+	device_stats.frames++;
+	unsigned int swapped = trace_ns();
+	if(renderer->latency >= 0){
+		LatencySample* sample = &latency_samples[renderer->latency];
+		sample->swap = swapped;
+		sample->shown = true;
+		renderer->latency = -1;
+	}
+	renderer->telemetry.value[TELEMETRY_SWAP] = (swapped - waited)/1000;
+	telemetry_record(&renderer->telemetry);
+}
+
+// the simulation only writes tail and the renderer only writes head, so
+// each side publishes its progress with a release store and no lock is needed
+GameFrame* queue_reserve(FrameQueue* queue){
+	int next = (queue->tail + 1) % FRAME_QUEUE_SIZE;
+	if(next == __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE)) return NULL; // full
+	return &queue->slots[queue->tail];
+}
+
+void queue_publish(FrameQueue* queue){
+	__atomic_store_n(&queue->tail, (queue->tail + 1) % FRAME_QUEUE_SIZE, __ATOMIC_RELEASE);
+}
+
+GameFrame* queue_front(FrameQueue* queue){
+	if(queue->head == __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE)) return NULL; // empty
+	return &queue->slots[queue->head];
+}
+
+void queue_release(FrameQueue* queue){
+	__atomic_store_n(&queue->head, (queue->head + 1) % FRAME_QUEUE_SIZE, __ATOMIC_RELEASE);
+}
+
+void run_game(){
+	start_game(&game);
+	setup_devices();
+	start_renderer(&renderer, &game.world.ball);
+	
+	// one core: the same hand-off as the two thread split, but each frame is
+	// published and drawn before the next one is simulated
+	while(game_running()){
+		GameFrame* frame = queue_reserve(&frame_queue);
+		prepare_frame(&game, frame);
+		queue_publish(&frame_queue);
+		
+		render_frame(&renderer, queue_front(&frame_queue));
+		queue_release(&frame_queue);
+		
+		advance_game(&game);
+		present_frame(&renderer);
+		frames_run++;
+	}
+}
+
+#ifdef HOST_BUILD
+// DUNE_LIBRARY leaves out main, to link the game into another program
+#ifndef DUNE_LIBRARY
+int main(int argc, char** argv){
+	const char* record_path = NULL;
+	const char* replay_path = NULL;
+	const char* golden_path = NULL;
+	int sweep_count = 0;
+	int threads = 0;
+	bool split = false;
+	bool latency = false;
+	bool devices = false;
+	const char* telemetry_path = NULL;
+	const char* audio_path = NULL;
+	const char* capture_path = NULL;
+	for (int i = 1; i < argc; i++){
+		if (!strcmp(argv[i], "--seed") && i+1 < argc) terrain_seed = strtoul(argv[++i], NULL, 0);
+		else if (!strcmp(argv[i], "--frames") && i+1 < argc) max_frames = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--record") && i+1 < argc) record_path = argv[++i];
+		else if (!strcmp(argv[i], "--replay") && i+1 < argc) replay_path = argv[++i];
+		else if (!strcmp(argv[i], "--script")) input_mode = INPUT_SCRIPT;
+		else if (!strcmp(argv[i], "--split")) split = true;
+		else if (!strcmp(argv[i], "--latency")) latency = true;
+		else if (!strcmp(argv[i], "--devices")) devices = true;
+		else if (!strcmp(argv[i], "--attract")) attract_delay = 0;
+		else if (!strcmp(argv[i], "--audio") && i+1 < argc) audio_path = argv[++i];
+		else if (!strcmp(argv[i], "--capture") && i+1 < argc) capture_path = argv[++i];
+		else if (!strcmp(argv[i], "--telemetry") && i+1 < argc) telemetry_path = argv[++i];
+		else if (!strcmp(argv[i], "--telemetry-dump") && i+1 < argc){
+			const char* path = argv[++i];
+			unsigned int first = i+1 < argc ? strtoul(argv[++i], NULL, 0) : 0;
+			unsigned int count = i+1 < argc ? strtoul(argv[++i], NULL, 0) : 0;
+			if (!telemetry_dump(stdout, path, first, count)){
+				fprintf(stderr, "cannot read telemetry %s\n", path);
+				return 1;
+			}
+			return 0;
+		}
+		else if (!strcmp(argv[i], "--raster-threads") && i+1 < argc) raster_threads = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--golden-record") && i+1 < argc) golden_path = argv[++i], golden_mode = GOLDEN_RECORD;
+		else if (!strcmp(argv[i], "--golden-check") && i+1 < argc) golden_path = argv[++i], golden_mode = GOLDEN_CHECK;
+		else if (!strcmp(argv[i], "--dump") && i+1 < argc) golden_dump_path = argv[++i];
+		else if (!strcmp(argv[i], "--gen-tables")){
+			gen_tables(stdout);
+			return 0;
+		}
+		else if (!strcmp(argv[i], "--bench-raster")){
+			host_init();
+			bench_raster(stdout);
+			return 0;
+		}
+		else if (!strcmp(argv[i], "--sweep") && i+1 < argc) sweep_count = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--threads") && i+1 < argc) threads = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--bench-env")){
+			bench_env(stdout, i+1 < argc ? atol(argv[++i]) : 4000000);
+			return 0;
+		}
+		else if (!strcmp(argv[i], "--check-env")){
+			host_init();
+			return check_env(stdout, i+1 < argc ? strtoul(argv[++i], NULL, 0) : DEFAULT_TERRAIN_SEED) ? 0 : 1;
+		}
+		else if (!strcmp(argv[i], "--bench-riders")){
+			host_init();
+			bench_riders(stdout);
+			return 0;
+		}
+		else if (!strcmp(argv[i], "--bench-frames")){
+			host_init();
+			bench_frames(stdout, i+1 < argc ? atoi(argv[++i]) : 600);
+			return 0;
+		}
+		else if (!strcmp(argv[i], "--bench-physics")){
+			bench_physics(stdout, i+1 < argc ? atol(argv[++i]) : 1000000);
+			return 0;
+		}
+		else{
+			fprintf(stderr, "usage: %s [--seed n] [--frames n] [--record file | --replay file | --script] [--split] [--raster-threads n] [--latency] [--devices] [--attract] [--audio file.wav]\n"
+					"	[--capture file.y4m | file.rgb]\n"
+					"	[--telemetry file | --telemetry-dump file [first [count]]]\n"
+					"	[--golden-record file | --golden-check file [--dump image.ppm]]\n"
+					"	[--bench-raster | --bench-physics [steps] | --bench-riders | --bench-env [steps] | --bench-frames [frames]]\n"
+					"	[--check-env [seed]]\n"
+					"	[--sweep n [--threads n] [--frames n]]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (sweep_count > 0){
+		run_sweep(stdout, sweep_count, threads, max_frames > 0 ? max_frames : SWEEP_FRAMES);
+		return 0;
+	}
+	if (golden_mode != GOLDEN_OFF){
+		particle_budget_ns = 0; // the hashes must not depend on how busy the machine is
+		golden_file = fopen(golden_path, golden_mode == GOLDEN_RECORD ? "w" : "r");
+		if (!golden_file){
+			fprintf(stderr, "cannot open golden hashes %s\n", golden_path);
+			return 1;
+		}
+	}
+	host_init();
+	if (telemetry_path && !telemetry_output(telemetry_path)){
+		fprintf(stderr, "cannot write telemetry %s\n", telemetry_path);
+		return 1;
+	}
+	if (audio_path && !audio_output(audio_path)){
+		fprintf(stderr, "cannot write audio %s\n", audio_path);
+		return 1;
+	}
+	if (capture_path && !capture_output(capture_path)){
+		fprintf(stderr, "cannot write capture %s\n", capture_path);
+		return 1;
+	}
+	if (replay_path){
+		if (!load_trace(replay_path)){
+			fprintf(stderr, "cannot read input trace %s\n", replay_path);
+			return 1;
+		}
+	}
+	else if (record_path) input_mode = INPUT_RECORD;
+	// without a trace or a frame limit there is nothing to stop the game
+	else if (max_frames == 0) max_frames = 60*60;
+	
+	if (split) run_split();
+	else run_game();
+	if (latency) latency_report();
+	if (audio_path) audio_report();
+	if (devices) device_report();
+	if (!audio_finish()){
+		fprintf(stderr, "cannot write audio %s\n", audio_path);
+		return 1;
+	}
+	if (!telemetry_finish()){
+		fprintf(stderr, "cannot write telemetry %s\n", telemetry_path);
+		return 1;
+	}
+	if (!capture_finish()){
+		fprintf(stderr, "cannot write capture %s\n", capture_path);
+		return 1;
+	}
+	log_drain();
+	
+	if (record_path && !save_trace(record_path)){
+		fprintf(stderr, "cannot write input trace %s\n", record_path);
+		return 1;
+	}
+	printf("%d frames, score %d\n", frames_run, final_score);
+	if (golden_file) fclose(golden_file);
+	if (golden_mismatch >= 0){
+		printf("presented frame %d does not match the golden hash, written to %s\n", golden_mismatch, golden_dump_path);
+		return 1;
+	}
+	if (golden_end >= 0){
+		printf("golden file ends at frame %d, record it with as many frames as the run\n", golden_end);
+		return 1;
+	}
+	return 0;
+}
+#endif
+
+// host device models: they stand in for the hardware behind the registers,
+// so they use host_io directly and are not counted by the device layer
+
+// the pixel controller starts with both buffers in on-chip memory
+void host_init(){
+	volatile int * pixel_ctrl_ptr = IO(PIXEL_BUF_CTRL_BASE);
+	*pixel_ctrl_ptr = FPGA_ONCHIP_BASE;
+	*(pixel_ctrl_ptr + 1) = FPGA_ONCHIP_BASE;
+	build_layers(); // for the benches, which skip setup_devices
+}
+
+// the swap completes immediately
+void wait_for_vsync(){
+	volatile int * pixel_ctrl_ptr = IO(PIXEL_BUF_CTRL_BASE);
+	// no real wait, so the idle tasks get as much as their budgets allow
+	idle_new_frame();
+	while (idle_step());
+	frame_presented(*(pixel_ctrl_ptr + 1));
+	int front = *pixel_ctrl_ptr;
+	*pixel_ctrl_ptr = *(pixel_ctrl_ptr + 1);
+	*(pixel_ctrl_ptr + 1) = front;
+}
+
+// called with the buffer that is about to be shown
+void frame_presented(int buffer){
+	frames_presented++;
+	capture_frame(buffer);
+	if (golden_mode == GOLDEN_OFF || golden_mismatch >= 0 || golden_end >= 0) return;
+	unsigned long long hash = hash_frame(buffer);
+	if (golden_mode == GOLDEN_RECORD){
+		fprintf(golden_file, "%016llx\n", hash);
+		return;
+	}
+	unsigned long long expected;
+	if (fscanf(golden_file, "%llx", &expected) != 1){
+		golden_end = frames_presented - 1;
+		__atomic_store_n(&stop_requested, true, __ATOMIC_RELAXED);
+	}
+	else if (expected != hash){
+		golden_mismatch = frames_presented;
+		write_ppm(golden_dump_path, buffer);
+		__atomic_store_n(&stop_requested, true, __ATOMIC_RELAXED);
+	}
+}
+
+// FNV-1a over the visible pixels
+unsigned long long hash_frame(int buffer){
+	unsigned long long hash = 14695981039346656037ULL;
+	for (int y = 0; y < RESOLUTION_Y; y++){
+		unsigned char* row = (unsigned char *)BUS(buffer + (y << 10));
+		for (int i = 0; i < 2*RESOLUTION_X; i++){
+			hash ^= row[i];
+			hash *= 1099511628211ULL;
+		}
+	}
+	return hash;
+}
+
+bool write_ppm(const char* path, int buffer){
+	FILE* file = fopen(path, "wb");
+	if (!file) return false;
+	fprintf(file, "P6\n%d %d\n255\n", RESOLUTION_X, RESOLUTION_Y);
+	for (int y = 0; y < RESOLUTION_Y; y++){
+		unsigned short* row = (unsigned short *)BUS(buffer + (y << 10));
+		for (int x = 0; x < RESOLUTION_X; x++){
+			// expand RGB565 to 8 bits per channel
+			unsigned char rgb[3] = {((row[x] >> 11) & 0x1F) * 255/31, ((row[x] >> 5) & 0x3F) * 255/63, (row[x] & 0x1F) * 255/31};
+			fwrite(rgb, 1, 3, file);
+		}
+	}
+	return fclose(file) == 0;
+}
+#else
+int main(void){
+	run_game();
+	return 0;
+}
+
+void wait_for_vsync(){
+    int status;
+    
+    dev_write(PIXEL_BUF_CTRL_BASE, 1); //write 1 in front buffer to launch the swap process
+    idle_new_frame();
+    status = dev_read(PIXEL_BUF_CTRL_BASE + 12); //poll the status bit of the status register, the other bit is A
+    while((status & 0x01)!=0){
+        idle_step(); // one short piece of background work, then check again
+        status = dev_read(PIXEL_BUF_CTRL_BASE + 12);
+    }
+    //after the swap, status bit will be 0
+}
+#endif
+
+#ifdef HOST_BUILD
+static inline bool log_putc(char c){
+	fputc(c, log_file ? log_file : stdout);
+	return true;
+}
+#else
+// never waits: false when the JTAG UART write FIFO is full
+static inline bool log_putc(char c){
+	if ((dev_read(JTAG_UART_BASE + 4) & 0xFFFF0000) == 0) return false; // WSPACE
+	dev_write(JTAG_UART_BASE, c);
+	return true;
+}
+#endif
+
+// format into the next free slot; the message is dropped and counted if the
+// ring is full, so logging never blocks the frame
+bool log_printf(const char* format, ...){
+	unsigned int pos = __atomic_load_n(&log_ring.head, __ATOMIC_RELAXED);
+	LogSlot* slot;
+	unsigned int free_turn;
+	for(;;){
+		slot = &log_ring.slots[pos % LOG_SLOTS];
+		free_turn = 2*(pos / LOG_SLOTS);
+		int ahead = (int) (__atomic_load_n(&slot->turn, __ATOMIC_ACQUIRE) - free_turn);
+		if (ahead == 0){
+			if (__atomic_compare_exchange_n(&log_ring.head, &pos, pos+1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				break;
+		}
+		else if (ahead < 0){ // still holds the message from the last lap
+			__atomic_fetch_add(&log_ring.dropped, 1, __ATOMIC_RELAXED);
+			return false;
+		}
+		else pos = __atomic_load_n(&log_ring.head, __ATOMIC_RELAXED);
+	}
+	va_list args;
+	va_start(args, format);
+	vsnprintf(slot->text, LOG_LINE, format, args);
+	va_end(args);
+	__atomic_store_n(&slot->turn, free_turn + 1, __ATOMIC_RELEASE);
+	return true;
+}
+
+// idle task: send one message, or as much of it as the output takes, and
+// once the ring is empty say how many messages were lost
+bool log_step(void* arg){
+	(void) arg;
+	unsigned int pos = log_ring.tail;
+	LogSlot* slot = &log_ring.slots[pos % LOG_SLOTS];
+	unsigned int full_turn = 2*(pos / LOG_SLOTS) + 1;
+	if (__atomic_load_n(&slot->turn, __ATOMIC_ACQUIRE) != full_turn){
+		unsigned int dropped = __atomic_load_n(&log_ring.dropped, __ATOMIC_RELAXED);
+		if (dropped == log_ring.reported) return false;
+		// the ring is empty, so this only fails if other threads refilled it
+		if (!log_printf("log: %u messages dropped\n", dropped - log_ring.reported)) return false;
+		log_ring.reported = dropped;
+		return true;
+	}
+	bool sent = false;
+	while (slot->text[log_ring.offset]){
+		if (!log_putc(slot->text[log_ring.offset])) return sent; // the rest goes next time
+		log_ring.offset++;
+		sent = true;
+	}
+	log_ring.offset = 0;
+	log_ring.tail = pos + 1;
+	__atomic_store_n(&slot->turn, full_turn + 1, __ATOMIC_RELEASE);
+	return true;
+}
+
+// send everything the output takes right now
+void log_drain(){
+	while (log_step(NULL));
+}
+
+// add a background task; budget caps its steps per frame
+int idle_add(const char* name, bool (*step)(void* arg), void* arg, int budget){
+	if (idle_task_count == MAX_IDLE_TASKS) return -1;
+	IdleTask* task = &idle_tasks[idle_task_count];
+	task->name = name;
+	task->step = step;
+	task->arg = arg;
+	task->budget = budget;
+	task->used = 0;
+	task->steps = 0;
+	return idle_task_count++;
+}
+
+// a new frame's wait begins: every task gets its budget back
+void idle_new_frame(){
+	for(int i = 0; i < idle_task_count; i++) idle_tasks[i].used = 0;
+}
+
+// run one step of the next task, round robin, that has budget left and work
+// to do; false when none of them did anything, so the caller just polls
+bool idle_step(){
+	for(int tried = 0; tried < idle_task_count; tried++){
+		IdleTask* task = &idle_tasks[idle_next];
+		idle_next = (idle_next + 1) % idle_task_count;
+		if (task->used >= task->budget) continue;
+		if (task->step(task->arg)){
+			task->used++;
+			task->steps++;
+			return true;
+		}
+	}
+	return false;
+}
+
+void save_frame(FrameSnapshot* snap, int buffer){
+	snap->buffer = buffer;
+	for(int y = 0; y < RESOLUTION_Y; y++){
+		memcpy(snap->pixels[y], BUS(buffer + (y << 10)), sizeof(snap->pixels[y]));
+	}
+}
+
+static void restore_pass(void* arg){
+	FrameSnapshot* snap = arg;
+	for(int y = band_top; y < band_bottom; y++){
+		memcpy(BUS(snap->buffer + (y << 10)), snap->pixels[y], sizeof(snap->pixels[y]));
+	}
+}
+
+void restore_frame(FrameSnapshot* snap){
+	raster_parallel(restore_pass, snap);
+}
+
+// both buffers are written directly so no extra vsync is needed
+void restore_initial_frames(){
+	restore_frame(&initial_frames[0]);
+	restore_frame(&initial_frames[1]);
+}
+
+// set up the ball at its starting point and the dunes at the start of the terrain
+void reset_world(World* world, const int* points, const double* angles, const double* heights){
+	Ball ball = {.x = BALL_X, .y = BALL_Y, .dx = 0, .dy = 0, .color = RED, .radius = BALL_R, 
+				 .x1 = BALL_X, .y1 = BALL_Y, .x2 = BALL_X, .y2 = BALL_Y};
+	world->ball = ball;
+	world->currentX = 0;
+	world->terrainPoints = points;
+	world->terrainAngles = angles;
+	world->terrainHeights = heights;
+	world->dune.dunePoints = points;
+	world->dune.duneAngles = angles;
+	world->dune.dunePoints1 = flat_dune;
+	world->dune.dunePoints2 = flat_dune;
+}
+
+// advance the game by one frame: scroll the dunes, move the ball and
+// resolve contact with the dunes; returns STEP_CONTACT and STEP_CRASH flags
+int physics_step(World* world, bool spacebar){
+	Ball* ball = &world->ball;
+	Dune* dune = &world->dune;
+	double acceleration;
+	if(spacebar) acceleration = MAX_ACCELERATION;
+	else acceleration = MIN_ACCELERATION;
+	
+	// world position of the ball before scrolling
+	double ballX = world->currentX + ball->x;
+	
+	//update dune
+	world->currentX+= ball->dx;
+	if(world->currentX >= NUM_DUNES*DUNE_PERIOD) world->currentX -= NUM_DUNES*DUNE_PERIOD;
+	// slide the window; the older windows are where the buffers were drawn
+	int start = (int) world->currentX;
+	dune->dunePoints2 = dune->dunePoints1;
+	dune->dunePoints1 = dune->dunePoints;
+	dune->dunePoints = world->terrainPoints + start;
+	dune->duneAngles = world->terrainAngles + start;
+	
+	return resolve_ball(world, ballX, world->currentX + ball->x, &ball->y, &ball->dx, &ball->dy, ball->radius, acceleration);
+}
+
+// move one ball from world position fromX to toX, bouncing off the terrain;
+// shared by the player and the riders so they follow exactly the same rules
+static inline int resolve_ball(const World* world, double fromX, double toX, int* y, double* dx, double* dy, int radius, double acceleration){
+	int result = 0;
+	int by = *y;
+	double vx = *dx;
+	double vy = *dy;
+	
+	// sweep the bottom of the ball along this frame's path
+	double fall = vy + 0.5*acceleration;
+	double hit = sweep_ball(world, fromX, by + radius, vx, fall);
+	if(hit < 0 && by + fall > RESOLUTION_Y) hit = 1;
+	
+	//update ball speeds
+	if(hit >= 0){
+		result |= STEP_CONTACT;
+		
+		// the rest of the frame is spent in the bounce; stay on the dune under
+		// the ball, or at the height of impact if a crest was passed
+		double hitX = fromX + hit*vx;
+		by = min(terrain_floor(world, hitX, radius), terrain_floor(world, toX, radius)) - radius;
+		double duneAngle = atan(terrain_slope(world, hitX));
+		double ballAngle = atan(vy/vx);
+		double speed = sqrt(vx*vx + vy*vy);
+		
+		if(vx < 0 && duneAngle < 0 && acceleration == MIN_ACCELERATION) ;
+		else if(duneAngle > 0 && ballAngle >= 0){
+			double dx1 = speed*cos(ballAngle - duneAngle) + acceleration;
+
+			vx = dx1*cos(duneAngle);
+			vy = dx1*sin(duneAngle);
+		}
+		else if(duneAngle < 0 && ballAngle < 0){
+			duneAngle = - duneAngle;
+			ballAngle = - ballAngle;
+			
+			double dx1 = speed*cos(duneAngle - ballAngle) + acceleration;
+			
+			vx = dx1*cos(duneAngle);
+			vy = -dx1*sin(duneAngle);
+		}
+		else if(duneAngle < 0 && ballAngle >= 0){		
+			duneAngle = - duneAngle;
+			double dx1 = speed*cos(duneAngle + ballAngle) + acceleration;
+			if(ballAngle >= PI/2 - duneAngle && speed > MAX_SPEED) result |= STEP_CRASH;
+			
+			vx = dx1*cos(duneAngle);
+			vy = -dx1*sin(duneAngle);
+		}
+		else if(duneAngle == 0){
+			vy = (int) -(vy + acceleration);
+			vy += acceleration;
+			if(vx < 1) vx = acceleration;
+		}
+		else{
+			vy += acceleration;
+		}
+		
+		
+		//update ball speed to maximum
+		speed = min(MAX_SPEED, sqrt(vx*vx + vy*vy));
+		ballAngle = atan(vy/vx);
+		
+		vy = speed*sin(ballAngle);
+		vx = speed*cos(ballAngle);
+		
+		if(((int) vx == 0) && duneAngle < 0) vx = -1;
+	}
+	else{
+		by += fall;
+		vy += 0.5*acceleration;
+	}
+	*y = by;
+	*dx = vx;
+	*dy = vy;
+	return result;
+}
+
+// the terrain as a function of world position, before it is sampled into columns
+static double terrain_phase(double x, int* dune){
+	// fmod returns an x already on the terrain unchanged, so it is skipped there
+	if(x < 0 || x >= NUM_DUNES*DUNE_PERIOD){
+		x = fmod(x, NUM_DUNES*DUNE_PERIOD);
+		if(x < 0) x += NUM_DUNES*DUNE_PERIOD;
+	}
+	*dune = min(NUM_DUNES-1, (int) (x / DUNE_PERIOD));
+	return DUNE_FREQUENCY*(x - *dune*DUNE_PERIOD);
+}
+
+double terrain_height(const World* world, double x){
+	int dune;
+	double phase = terrain_phase(x, &dune);
+	return world->terrainHeights[dune]*sin(phase) + MIDDLE_DUNE;
+}
+
+// top of the drawn dune under a ball at x: the highest of the columns within
+// radius-1 of the ball's column, so no part of the ball rests inside a slope
+int terrain_floor(const World* world, double x, int radius){
+	if(x < 0 || x >= NUM_DUNES*DUNE_PERIOD) x = fmod(x, NUM_DUNES*DUNE_PERIOD);
+	int centre = (int) floor(x);
+	if(centre < 0) centre += NUM_DUNES*DUNE_PERIOD;
+	int top = world->terrainPoints[centre];
+	for(int i = 1; i < radius; i++){
+		// the store repeats its first screen, so centre+i needs no wrap
+		int left = centre - i < 0 ? centre - i + NUM_DUNES*DUNE_PERIOD : centre - i;
+		top = min(top, min(world->terrainPoints[left], world->terrainPoints[centre + i]));
+	}
+	return top;
+}
+
+double terrain_slope(const World* world, double x){
+	int dune;
+	double phase = terrain_phase(x, &dune);
+	return world->terrainHeights[dune]*DUNE_FREQUENCY*cos(phase);
+}
+
+// Time of impact in [0, 1] of a point moving from (x0, y0) by (dx, dy) against
+// the terrain, or -1 if it stays above it. The gap y - height is split into
+// monotonic pieces at dune boundaries and where the terrain slope equals the
+// path's, so the first piece that ends below the terrain holds the only root.
+double sweep_ball(const World* world, double x0, double y0, double dx, double dy){
+	double t[16];
+	int n = 0;
+	t[n++] = 0;
+	t[n++] = 1;
+	if(dx != 0){
+		double x1 = x0 + dx;
+		double lo = x0 < x1 ? x0 : x1;
+		double hi = x0 < x1 ? x1 : x0;
+		for(int k = (int) floor(lo / DUNE_PERIOD); k*DUNE_PERIOD <= hi && n < 14; k++){
+			// dune boundary
+			if(k*DUNE_PERIOD > lo) t[n++] = (k*DUNE_PERIOD - x0) / dx;
+			// slope of the path matches the slope of this dune, dune k of the looping terrain
+			int dune = (k % NUM_DUNES + NUM_DUNES) % NUM_DUNES;
+			double c = dy / dx / (world->terrainHeights[dune]*DUNE_FREQUENCY);
+			if(c < -1 || c > 1) continue;
+			double angle = acos(c);
+			double u[2] = {angle, 2*PI - angle};
+			for(int i = 0; i < 2; i++){
+				double x = k*DUNE_PERIOD + u[i] / (DUNE_FREQUENCY);
+				if(x > lo && x < hi) t[n++] = (x - x0) / dx;
+			}
+		}
+	}
+	// sort the breakpoints
+	for(int i = 1; i < n; i++){
+		for(int j = i; j > 0 && t[j] < t[j-1]; j--){
+			double temp = t[j];
+			t[j] = t[j-1];
+			t[j-1] = temp;
+		}
+	}
+	
+	double a = 0;
+	double fa = y0 - terrain_height(world, x0);
+	if(fa > 0) return 0;
+	for(int i = 1; i < n; i++){
+		double b = t[i];
+		double fb = y0 + b*dy - terrain_height(world, x0 + b*dx);
+		if(fb > 0){
+			// bisection steps narrow the bracket, then a secant step lands on the root
+			for(int iter = 0; iter < 6; iter++){
+				double m = 0.5*(a + b);
+				double fm = y0 + m*dy - terrain_height(world, x0 + m*dx);
+				if(fm > 0){
+					b = m;
+					fb = fm;
+				}
+				else{
+					a = m;
+					fa = fm;
+				}
+			}
+			return a - fa*(b - a)/(fb - fa);
+		}
+		a = b;
+		fa = fb;
+	}
+	return -1;
+}
+
+void reset_riders(Riders* riders, int count){
+	riders->count = min(count, MAX_RIDERS);
+	for(int i = 0; i < riders->count; i++){
+		riders->scroll[i] = 0;
+		riders->dx[i] = 0;
+		riders->dy[i] = 0;
+		riders->y[i] = BALL_Y;
+		riders->spacebar[i] = false;
+		riders->alive[i] = true;
+		riders->color[i] = GHOST_COLOR;
+		riders->x1[i] = riders->x2[i] = -1;
+	}
+}
+
+// step every rider against the shared terrain; the scroll update is a plain
+// loop over the arrays that the compiler can vectorise, contact is per rider
+void riders_step(Riders* riders, const World* world){
+	int n = riders->count;
+	for(int i = 0; i < n; i++){
+		riders->fromX[i] = riders->scroll[i] + BALL_X;
+		riders->scroll[i] += riders->dx[i];
+		riders->scroll[i] -= (riders->scroll[i] >= NUM_DUNES*DUNE_PERIOD) ? NUM_DUNES*DUNE_PERIOD : 0;
+	}
+	for(int i = 0; i < n; i++){
+		if(!riders->alive[i]) continue;
+		double acceleration = riders->spacebar[i] ? MAX_ACCELERATION : MIN_ACCELERATION;
+		int result = resolve_ball(world, riders->fromX[i], riders->scroll[i] + BALL_X,
+								  &riders->y[i], &riders->dx[i], &riders->dy[i], BALL_R, acceleration);
+		if(result & STEP_CRASH) riders->alive[i] = false;
+	}
+}
+
+// half widths of the rows of a BALL_R circle, from the midpoint algorithm in draw_ball
+static int ball_spans[2*BALL_R+1];
+
+static void build_ball_spans(){
+	int x = BALL_R, y = 0;
+	int P = 1 - BALL_R;
+	ball_spans[BALL_R] = BALL_R;
+	while (x > y){
+		y++;
+		if (P <= 0) P = P + 2*y + 1;
+		else{
+			x--;
+			P = P + 2*y - 2*x + 1;
+		}
+		if (x < y) break;
+		ball_spans[BALL_R+y] = ball_spans[BALL_R-y] = x;
+		if (x != y) ball_spans[BALL_R+x] = ball_spans[BALL_R-x] = y;
+	}
+}
+
+// draw every live rider that is fully on screen, behind the player
+void draw_riders(Riders* riders, double currentX){
+	if(ball_spans[BALL_R] == 0) build_ball_spans();
+	for(int i = 0; i < riders->count; i++){
+		riders->x2[i] = riders->x1[i];
+		riders->y2[i] = riders->y1[i];
+		riders->x1[i] = -1;
+		if(!riders->alive[i]) continue;
+		// screen position relative to the player's scroll, across the wrap
+		double offset = riders->scroll[i] - currentX;
+		if(offset > NUM_DUNES*DUNE_PERIOD/2) offset -= NUM_DUNES*DUNE_PERIOD;
+		if(offset < -NUM_DUNES*DUNE_PERIOD/2) offset += NUM_DUNES*DUNE_PERIOD;
+		int xc = BALL_X + (int) offset;
+		int yc = riders->y[i];
+		if(xc < BALL_R || xc >= RESOLUTION_X-BALL_R) continue;
+		for(int row = -BALL_R; row <= BALL_R; row++){
+			if(in_y_bounds(yc+row))
+				solid_horizontal(xc-ball_spans[BALL_R+row], xc+ball_spans[BALL_R+row], yc+row, riders->color[i]);
+		}
+		riders->x1[i] = xc;
+		riders->y1[i] = yc;
+	}
+}
+
+// erase the riders drawn into this buffer two frames ago, putting back the
+// dune as it was then so clear_running_dune still sees the old heights
+void clear_riders(Riders* riders, Dune* dune){
+	terrain_under = dune->dunePoints2;
+	for(int i = 0; i < riders->count; i++){
+		int xc = riders->x2[i];
+		int yc = riders->y2[i];
+		if(xc < 0) continue;
+		for(int row = -BALL_R; row <= BALL_R; row++){
+			if(in_y_bounds(yc+row))
+				terrain_horizontal(xc-ball_spans[BALL_R+row], xc+ball_spans[BALL_R+row], yc+row, 0);
+		}
+	}
+}
+
+void reset_particles(Particles* particles){
+	particles->count = 0;
+	particles->cap = MAX_PARTICLES;
+	particles->seed = 1;
+	particles->scroll = 0;
+}
+
+// grain velocity in PARTICLE_FIXED units, uniform in [low, high)
+static inline int particle_rand(Particles* particles, int low, int high){
+	return low + terrain_rand(&particles->seed)*(high - low)/0x8000;
+}
+
+// move every grain with the dunes, bury the ones that fall into them, drop
+// the ones that are dead and erased from both buffers, then throw up new
+// sand for this frame: a spray on landing and a trail at high speed
+void particles_step(Particles* particles, const GameFrame* frame){
+	int scroll = (int) ((frame->currentX - particles->scroll)*PARTICLE_FIXED);
+	if(frame->currentX < particles->scroll) scroll += NUM_DUNES*DUNE_PERIOD*PARTICLE_FIXED; // across the wrap
+	particles->scroll = frame->currentX;
+	const int* under = frame->dune.dunePoints;
+	int n = particles->count;
+	for(int i = 0; i < n; i++){
+		if(particles->life[i] == 0) continue;
+		int x = particles->x[i] + particles->dx[i] - scroll;
+		int y = particles->y[i] + particles->dy[i];
+		particles->x[i] = x;
+		particles->y[i] = y;
+		particles->dy[i] += PARTICLE_GRAVITY;
+		particles->life[i]--;
+		// x is checked before dividing, which rounds toward zero
+		int px = x/PARTICLE_FIXED;
+		if(x < 0 || px >= RESOLUTION_X-1 || y/PARTICLE_FIXED >= under[px]) particles->life[i] = 0;
+	}
+	// the pixel drawn two frames ago was erased before this step, so only
+	// the one drawn last frame keeps a dead grain in the pool
+	for(int i = 0; i < n; ){
+		if(particles->life[i] == 0 && particles->x1[i] < 0){
+			n--;
+			particles->x[i] = particles->x[n];
+			particles->y[i] = particles->y[n];
+			particles->dx[i] = particles->dx[n];
+			particles->dy[i] = particles->dy[n];
+			particles->life[i] = particles->life[n];
+			particles->color[i] = particles->color[n];
+			particles->x1[i] = particles->x1[n];
+			particles->y1[i] = particles->y1[n];
+			particles->x2[i] = particles->x2[n];
+			particles->y2[i] = particles->y2[n];
+		}
+		else i++;
+	}
+	
+	int spray = (frame->stepFlags & STEP_LANDED) ? PARTICLE_SPRAY : 0;
+	// no trail while the ball is above the screen and only the arrow shows
+	int trail = (frame->ball.dx > PARTICLE_TRAIL_DX && in_y_bounds(frame->ball.y + BALL_R)) ? PARTICLE_TRAIL : 0;
+	int speed = (int) (frame->ball.dx*PARTICLE_FIXED);
+	for(int k = 0; k < spray + trail && n < particles->cap; k++, n++){
+		particles->x2[n] = particles->x1[n] = -1;
+		if(k < spray){
+			// kicked up off the ball's path, falling behind it
+			particles->x[n] = (BALL_X + particle_rand(particles, -BALL_R, BALL_R+1))*PARTICLE_FIXED;
+			particles->y[n] = (frame->ball.y + BALL_R - 1)*PARTICLE_FIXED;
+			particles->dx[n] = particle_rand(particles, speed/4, speed + PARTICLE_FIXED);
+			particles->dy[n] = (int) (frame->ball.dy*PARTICLE_FIXED) + particle_rand(particles, -8*PARTICLE_FIXED, -3*PARTICLE_FIXED);
+			particles->life[n] = PARTICLE_SPRAY_LIFE;
+			particles->color[n] = SAND_COLOR;
+		}
+		else{
+			// left in the air behind the ball
+			particles->x[n] = (BALL_X - BALL_R)*PARTICLE_FIXED;
+			particles->y[n] = (frame->ball.y + particle_rand(particles, -BALL_R, BALL_R+1))*PARTICLE_FIXED;
+			particles->dx[n] = speed/2;
+			particles->dy[n] = particle_rand(particles, -PARTICLE_FIXED, 0);
+			particles->life[n] = PARTICLE_TRAIL_LIFE;
+			particles->color[n] = TRAIL_COLOR;
+		}
+	}
+	particles->count = n;
+}
+
+// every live grain is a two pixel span, written straight to the buffer
+void draw_particles(Particles* particles){
+	for(int i = 0; i < particles->count; i++){
+		particles->x2[i] = particles->x1[i];
+		particles->y2[i] = particles->y1[i];
+		particles->x1[i] = -1;
+		if(particles->life[i] == 0 || particles->x[i] < 0 || particles->y[i] < 0) continue;
+		int x = particles->x[i]/PARTICLE_FIXED;
+		int y = particles->y[i]/PARTICLE_FIXED;
+		if(x >= RESOLUTION_X-1 || !IN_BAND(y)) continue; // both pixels of the span on screen
+		ROP_SOLID(x, y, particles->color[i]);
+		ROP_SOLID(x+1, y, particles->color[i]);
+		particles->x1[i] = x;
+		particles->y1[i] = y;
+	}
+}
+
+// erase the grains drawn into this buffer two frames ago, like clear_riders
+void clear_particles(Particles* particles, Dune* dune){
+	terrain_under = dune->dunePoints2;
+	for(int i = 0; i < particles->count; i++){
+		int x = particles->x2[i];
+		int y = particles->y2[i];
+		if(x < 0) continue;
+		ROP_TERRAIN(x, y, 0);
+		ROP_TERRAIN(x+1, y, 0);
+	}
+}
+
+// halve the grains allowed after a frame over budget, and win them back slowly
+void particles_budget(Particles* particles, unsigned int renderTime){
+	if(particle_budget_ns && renderTime > particle_budget_ns)
+		particles->cap = max(particles->cap/2, PARTICLE_MIN_CAP);
+	else if(particles->cap < MAX_PARTICLES)
+		particles->cap++;
+}
+
+void record_run_input(int frame, bool spacebar){
+	if(frame >= MAX_TRACE_FRAMES) return;
+	if(spacebar) run_inputs[frame >> 3] |= 1 << (frame & 7);
+	else run_inputs[frame >> 3] &= ~(1 << (frame & 7));
+}
+
+// keep the run that just ended, dropping the oldest ghost
+void save_ghost(int frames){
+	for(int i = GHOST_RUNS-1; i > 0; i--){
+		memcpy(ghost_runs[i], ghost_runs[i-1], sizeof(ghost_runs[i]));
+		ghost_frames[i] = ghost_frames[i-1];
+	}
+	memcpy(ghost_runs[0], run_inputs, sizeof(run_inputs));
+	ghost_frames[0] = min(frames, MAX_TRACE_FRAMES);
+	ghost_count = min(GHOST_RUNS, ghost_count+1);
+}
+
+void spawn_ghosts(Riders* riders){
+	reset_riders(riders, ghost_count);
+}
+
+// feed each ghost the input its run had on this frame; a ghost ends with its run
+void ghost_inputs(Riders* riders, int frame){
+	for(int i = 0; i < riders->count; i++){
+		if(frame >= ghost_frames[i]){
+			riders->alive[i] = false;
+			continue;
+		}
+		riders->spacebar[i] = (ghost_runs[i][frame >> 3] >> (frame & 7)) & 1;
+	}
+}
+
+// fork the world once per plan and play each fork AUTOPILOT_HORIZON frames
+// ahead, plan p holding the spacebar for the first p/(AUTOPILOT_PLANS-1) of
+// them; a fork is a World copy, a few hundred bytes since the dunes are
+// windows into the terrain. Returns the first input of the plan that goes
+// furthest and flies over the score line most without crashing
+bool autopilot_choose(const World* world){
+	int best = 0;
+	double bestValue = 0;
+	for(int plan = 0; plan < AUTOPILOT_PLANS; plan++){
+		int hold = plan*AUTOPILOT_HORIZON / (AUTOPILOT_PLANS-1);
+		World fork = *world;
+		double value = 0;
+		for(int t = 0; t < AUTOPILOT_HORIZON; t++){
+			int prevY = fork.ball.y;
+			if(physics_step(&fork, t < hold) & STEP_CRASH){
+				value = t - 1e9; // the later the crash the better, if they all crash
+				break;
+			}
+			value += fork.ball.dx;
+			if(prevY > SCORE_LINE_Y && fork.ball.y < SCORE_LINE_Y) value += 2500;
+		}
+		if(plan == 0 || value > bestValue){
+			best = plan;
+			bestValue = value;
+		}
+	}
+	return best > 0;
+}
+
+// points for a frame: the distance travelled, plus the bonus for flying above the score line
+int add_score(int score, double dx, bool bonus){
+	if (bonus)
+		score += 2500;
+	return min(999999, score + dx);
+}
+
+// fill the world terrain from the seeded generator
+void build_terrain(unsigned int seed, int* points, double* angles, double* duneHeight){
+	TerrainBuild build;
+	terrain_begin(&build, seed, points, angles, duneHeight);
+	terrain_finish(&build);
+}
+
+// pick the dune heights; the columns are left to terrain_step
+void terrain_begin(TerrainBuild* build, unsigned int seed, int* points, double* angles, double* duneHeight){
+	unsigned int state = seed;
+	for(int i = 0; i < NUM_DUNES; i++){
+		duneHeight[i] = terrain_rand(&state)%(MAX_AMPLITUDE_DUNE-10)+10; //between 10 and MAX_AMPLITUDE_DUNE
+	}
+	build->points = points;
+	build->angles = angles;
+	build->heights = duneHeight;
+	build->next = 0;
+}
+
+// idle task: build the next TERRAIN_CHUNK columns
+bool terrain_step(void* arg){
+	TerrainBuild* build = arg;
+	if (!build->points || build->next == TERRAIN_STORE) return false; // not begun, or done
+	int end = min(build->next + TERRAIN_CHUNK, TERRAIN_STORE);
+	for(int x = build->next; x < end; x++){
+		if (x < NUM_DUNES*DUNE_PERIOD){
+			int amplitude = x/DUNE_PERIOD;
+			build->points[x] = (int) build->heights[amplitude]*dune_sine[x%DUNE_PERIOD] + MIDDLE_DUNE;
+			build->angles[x] = atan(build->heights[amplitude]*DUNE_FREQUENCY*dune_cosine[x%DUNE_PERIOD]);
+		}
+		else{
+			// the terrain loops, so the window past the end is the start again
+			build->points[x] = build->points[x - NUM_DUNES*DUNE_PERIOD];
+			build->angles[x] = build->angles[x - NUM_DUNES*DUNE_PERIOD];
+		}
+	}
+	build->next = end;
+	return true;
+}
+
+// build whatever idle time has not
+void terrain_finish(TerrainBuild* build){
+	while (terrain_step(build));
+}
+
+static void black_screen_pass(void* arg){
+	(void) arg;
+	for(int y = band_top; y < band_bottom; y++){
+		solid_horizontal(0, RESOLUTION_X-1, y, BLACK);
+	}
+}
+
+void black_screen(){
+	raster_parallel(black_screen_pass, NULL);
+}
+
+static void sky_pass(void* arg){
+	(void) arg;
+	int bottom = (band_bottom < LAYER_BOTTOM) ? band_bottom : LAYER_BOTTOM;
+	for(int y = band_top; y < bottom; y++){
+		memcpy(PIXEL_ADDR(0, y), &LAYER_AT(0, y), RESOLUTION_X*sizeof(short int));
+	}
+}
+
+static void background_pass(void* arg){
+	(void) arg;
+	sky_pass(NULL);
+	for(int y = (band_top > LAYER_BOTTOM) ? band_top : LAYER_BOTTOM; y < band_bottom; y++){
+		restore_horizontal(0, RESOLUTION_X-1, y, 0);
+	}
+}
+
+void draw_background(){
+	raster_parallel(background_pass, NULL);
+}
+
+// a*weight/scale + b*(1 - weight/scale) for each RGB565 channel, weight at most scale
+static short int blend_color(short int a, short int b, int weight, int scale){
+	if (weight > scale) weight = scale;
+	int red = (((a >> 11) & 0x1F)*weight + ((b >> 11) & 0x1F)*(scale - weight))/scale;
+	int green = (((a >> 5) & 0x3F)*weight + ((b >> 5) & 0x3F)*(scale - weight))/scale;
+	int blue = ((a & 0x1F)*weight + (b & 0x1F)*(scale - weight))/scale;
+	return (short int) ((red << 11) | (green << 5) | blue);
+}
+
+// render the gradient, far dunes and clouds into the sky strips once
+void build_layers(){
+	if (layers_built) return;
+	int farTop[LAYER_PERIOD];
+	for(int x = 0; x < LAYER_PERIOD; x++){
+		double phase = 2*PI*x/LAYER_PERIOD;
+		int top = LAYER_BOTTOM - 18 - (int) (9*sin(2*phase) + 6*sin(5*phase + 1));
+		farTop[x] = (top < CLOUD_BOTTOM) ? CLOUD_BOTTOM : top;
+	}
+	for(int y = 0; y < LAYER_BOTTOM; y++){
+		for(int x = 0; x < LAYER_PERIOD; x++){
+			short int color = background_rows[y];
+			if (y >= CLOUD_BOTTOM){
+				if (y >= farTop[x]) color = blend_color(FAR_DUNE_COLOR, color, LAYER_BOTTOM - y, FAR_DUNE_FADE);
+			}
+			else{
+				for(int i = 0; i < (int) (sizeof(cloud_puffs)/sizeof(cloud_puffs[0])); i++){
+					int dx = (x - cloud_puffs[i][0] + LAYER_PERIOD*3/2) % LAYER_PERIOD - LAYER_PERIOD/2; // nearest copy
+					int dy = y - cloud_puffs[i][1];
+					if (dx*dx + dy*dy <= cloud_puffs[i][2]*cloud_puffs[i][2]) color = CLOUD_COLOR;
+				}
+			}
+			layer_pixels[y][x] = color;
+		}
+		// repeat the first screen so any offset is one row copy
+		memcpy(&layer_pixels[y][LAYER_PERIOD], &layer_pixels[y][0], RESOLUTION_X*sizeof(short int));
+	}
+	layers_built = true;
+}
+
+// offsets of the layers scrolled to a fraction of the distance travelled
+void layer_scroll(double currentX, int* offsets){
+	int scroll = (int) currentX;
+	offsets[0] = (scroll >> CLOUD_SHIFT) % LAYER_PERIOD;
+	offsets[1] = (scroll >> FAR_DUNE_SHIFT) % LAYER_PERIOD;
+}
+
+void set_layers(double currentX){
+	layer_scroll(currentX, layer_offset);
+}
+
+// copy the sky rows at the current offsets, erasing whatever was drawn over them
+void draw_sky(){
+	raster_parallel(sky_pass, NULL);
+}
+
+void clear_screen(Ball* ball, Dune* dune, Arrow* arrow){
+	clear_rectangle(RESOLUTION_X-92, 5, RESOLUTION_X-4, 15);
+	
+	// clear ball and dunes
+	clear_ball(ball);
+	clear_arrow(arrow);
+	
+	// clear +2500
+	if (toClear > 0){
+		clear_rectangle(X_2500, Y_2500, X_2500+40, Y_2500+10);
+		toClear--;
+	}
+}
+
+void clear_rectangle(int x0, int y0, int x1, int y1){
+	for(int y = y0; y <= y1; y++)
+		restore_horizontal(x0, x1, y, 0);
+}
+
+void plot_pixel(int x, int y, short int line_color){
+    if (IN_BAND(y)) ROP_SOLID(x, y, line_color);
+}
+
+void clear_pixel(int x, int y){
+    if (IN_BAND(y)) ROP_RESTORE(x, y, 0);
+}
+
+void draw(Ball* ball, Dune* dune, Arrow* arrow, int score){
+	// check if the ball is even on the screen
+	draw_line(0, SCORE_LINE_Y, RESOLUTION_X-1, SCORE_LINE_Y, WHITE);
+	draw_score(score);
+	if (in_y_bounds(ball->y + ball->radius)){
+		draw_ball(ball);
+	}
+	else{
+		// update previous ball position anyways
+		ball->x2 = ball->x1;
+		ball->y2 = ball->y1;
+		ball->x1 = ball->x;
+		ball->y1 = ball->y;
+		// update and draw the arrow
+		update_arrow(arrow, ball->y);
+		draw_arrow(arrow);
+	}
+	if (toDraw > 0){
+		// every frame, the sky copy erases it
+		draw_2500(X_2500, Y_2500, WHITE);
+		toDraw--;
+		if (toDraw == 0)
+			toClear = 2;
+	}
+	draw_dune_slice(dune, BALL_X-BALL_R, BALL_X+BALL_R);
+}
+
+double distance(int x1, int y1, int x2, int y2);
+
+void draw_ball(Ball* ball){	
+	// update ball position
+	ball->x2 = ball->x1;
+	ball->y2 = ball->y1;
+	ball->x1 = ball->x;
+	ball->y1 = ball->y;
+	fill_ball(ball);
+}
+
+// rasterize the ball without touching its history
+void fill_ball(const Ball* ball){
+	int r = ball->radius;
+	int xc = ball->x; // x center
+	int yc = ball->y; // y center
+	int color = ball->color;
+    int x = r, y = 0;
+      
+	// plot horizontal and vertical diameters of the circle
+	if (in_y_bounds(yc)){
+		solid_horizontal(xc-x, xc+x, yc, color);
+	}
+      
+    // Initialising the value of P
+    int P = 1 - r;
+    while (x > y){ 
+        y++;  
+        if (P <= 0){ // midpoint is inside or on the permiter
+            P = P + 2*y + 1;
+		}
+        else{ // midpoint is outside the perimeter
+            x--;
+            P = P + 2*y - 2*x + 1;
+        }
+          
+        // All the perimeter points have already been drawn
+        if (x < y)
+            break;
+          
+        // draw lines
+		if (in_y_bounds(yc+y)){
+			solid_horizontal(xc-x, xc+x, yc+y, color);
+		}
+		if (in_y_bounds(yc-y)){
+			solid_horizontal(xc-x, xc+x, yc-y, color);
+		}
+		
+		// draw second pair of lines if we aren't on the edge of the octant
+        if (x != y){
+			if (in_y_bounds(yc+x)){
+				solid_horizontal(xc-y, xc+y, yc+x, color);
+			}
+			if (in_y_bounds(yc-x)){
+				solid_horizontal(xc-y, xc+y, yc-x, color);
+			}
+        }
+    } 
+}
+
+void clear_ball(Ball* ball){	
+	int r = ball->radius;
+	int xc = ball->x2; // x center 2 frames ago
+	int yc = ball->y2; // y center 2 frames ago
+    int x = r, y = 0;
+      
+	// plot horizontal and vertical diameters of the circle
+	if (in_y_bounds(yc)){
+		restore_horizontal(xc-x, xc+x, yc, 0);
+	}
+      
+    // Initialising the value of P
+    int P = 1 - r;
+    while (x > y){ 
+        y++;  
+        if (P <= 0){ // midpoint is inside or on the permiter
+            P = P + 2*y + 1;
+		}
+        else{ // midpoint is outside the perimeter
+            x--;
+            P = P + 2*y - 2*x + 1;
+        }
+          
+        // All the perimeter points have already been drawn
+        if (x < y)
+            break;
+          
+        // draw lines
+		if (in_y_bounds(yc+y)){
+			restore_horizontal(xc-x, xc+x, yc+y, 0);
+		}
+		if (in_y_bounds(yc-y)){
+			restore_horizontal(xc-x, xc+x, yc-y, 0);
+		}
+		
+		// draw second pair of lines if we aren't on the edge of the octant
+        if (x != y){
+			if (in_y_bounds(yc+x)){
+				restore_horizontal(xc-y, xc+y, yc+x, 0);
+			}
+			if (in_y_bounds(yc-x)){
+				restore_horizontal(xc-y, xc+y, yc-x, 0);
+			}
+        }
+    } 
+}
+
+static void dune_pass(void* arg){
+	Dune* dune = arg;
+	for(int i = 0; i < RESOLUTION_X; i++){
+		if (dune->dunePoints[i] < band_bottom)
+			solid_vertical(i, dune->dunePoints[i], RESOLUTION_Y-1, DUNE_COLOR);
+	}
+}
+
+void draw_dune(Dune* dune){
+	raster_parallel(dune_pass, dune);
+}
+
+void draw_dune_slice(Dune* dune, int x1, int x2){
+	for(int i = x1; i <=x2; i++){
+		if (dune->dunePoints[i] < RESOLUTION_Y)
+			solid_vertical(i, dune->dunePoints[i], RESOLUTION_Y-1, DUNE_COLOR);
+	}
+}
+
+void clear_running_dune(Dune* dune){
+	for(int x = 0; x < RESOLUTION_X; x++){
+		if(dune->dunePoints[x] > dune->dunePoints2[x]){
+			restore_vertical(x, dune->dunePoints2[x], dune->dunePoints[x], 0);
+		}
+		else{
+			solid_vertical(x, dune->dunePoints2[x], dune->dunePoints[x], DUNE_COLOR);
+		}
+	}
+}
+
+void clear_all_dune(Dune* dune){
+	for(int x = 0; x < RESOLUTION_X; x++){
+		solid_vertical(x, dune->dunePoints2[x], RESOLUTION_Y, BLACK);
+	}
+}
+
+	
+void draw_isosceles_triangle(int h, int w, int x, int y, short int color);
+void clear_isosceles_triangle(int h, int w, int x, int y, short int color);
+void draw_arrow(Arrow* arrow){
+	// update previous frames
+	arrow->h2 = arrow->h1;
+	arrow->h1 = arrow->h;
+	
+	// draw the triangle
+	int half = arrow->h/2;
+	draw_isosceles_triangle(half, half, arrow->x, arrow->y, arrow->color);
+	// draw rest of arrow
+	for (int i = 0; i < half; i++){
+		solid_horizontal(arrow->x-half/5, arrow->x+half/5, arrow->y+half+i, arrow->color);
+	}
+}
+
+void clear_arrow(Arrow* arrow){
+	// draw the triangle
+	int half = arrow->h2/2;
+	clear_isosceles_triangle(half, half, arrow->x, arrow->y, BLACK);
+	// draw rest of arrow
+	for (int i = 0; i < half; i++){
+		restore_horizontal(arrow->x-half/5, arrow->x+half/5, arrow->y+half+i, 0);
+	}
+}
+
+void draw_isosceles_triangle(int h, int w, int x, int y, short int color){
+	// x, y is tip of triangle
+	double slope = 2*h / w;
+	
+	// draw triangle from top down
+	for (int i = 0; i <= w; i++){
+		int dx = (int) round(i / slope);
+		solid_horizontal(x-dx, x+dx, y+i, color);
+	}
+}
+
+void clear_isosceles_triangle(int h, int w, int x, int y, short int color){
+	// x, y is tip of triangle
+	double slope = 2*h / w;
+	
+	// draw triangle from top down
+	for (int i = 0; i <= w; i++){
+		int dx = (int) round(i / slope);
+		restore_horizontal(x-dx, x+dx, y+i, 0);
+	}
+}
+
+void update_arrow(Arrow* arrow, int y){
+	y = -(y+BALL_R); // distance from bottom of ball to top of screen
+	int height = (int) round(y*ARROW_SCALE + MIN_ARROW_HEIGHT);
+	arrow->h = min(MAX_ARROW_HEIGHT, height);
+	
+	// update arrow color
+	int r = 0x1F; // 31
+	int b = 0x1F - y/2;
+	int g = 0x3F;
+	if (b < 0){
+		b = 0;
+		g = max(0, g-(y-62)/2);
+	}
+	arrow->color = (r << 11) | (g << 5) | b;
+}
+
+int min(int a, int b){
+	if (a < b) return a;
+	else return b;
+}
+
+int max(int a, int b){
+	if (a < b) return b;
+	else return a;
+}
+
+double distance(int x1, int y1, int x2, int y2){
+	return sqrt(pow((x1-x2), 2) + pow((y1-y2), 2));
+}
+
+// helper functions
+bool in_bounds(int x, int y){
+	return in_y_bounds(y) && in_x_bounds(x);	
+}
+
+bool in_y_bounds(int y){
+	return (y >= 0) && (y < RESOLUTION_Y);	
+}
+bool in_x_bounds(int x){
+	return (x >= 0) && (x < RESOLUTION_X);
+}
+
+//return true if ball is touching dune
+bool isBallTouchingDune(Ball* ball, Dune* dune){
+	if(ball->y > RESOLUTION_Y) return true;
+	for(int i = 0; i < ball->radius; i++){
+		if((ball->y + ball->radius) > dune->dunePoints[ball->x+i]) return true;
+		if((ball->y + ball->radius) > dune->dunePoints[ball->x-i]) return true;
+	}
+	return false;
+		
+}
+
+void draw_DUNE(short int color);
+void draw_press_space_to_start(int x, int y, short int color);
+void draw_starting_screen(short int color){
+    //moving ball
+	static int calculation = 1;
+	double accel = 1;
+    static Ball ball = {.x = BALL_X, .y = BALL_Y, .dx = 0, .dy = 0, .color = WHITE, .radius = BALL_R,
+						.x1 = BALL_X, .y1 = BALL_Y, .x2 = BALL_X, .y2 = BALL_Y};
+	ball.color = color;
+    // the title dune is a window onto its own generated terrain
+    static Dune dune = {title_dune_points, title_dune_angles, flat_dune, flat_dune};
+    if(calculation){
+		calculation = 0;
+		draw_press_space_to_start(83, 120,WHITE);
+	}
+    draw_DUNE(WHITE);
+	
+	clear_ball(&ball);
+    draw_ball(&ball);
+    draw_dune(&dune);
+        
+        
+   	if(isBallTouchingDune(&ball,&dune)){
+		for(int i = 0; i < ball.radius; i++){
+			if(ball.y+ball.radius > dune.dunePoints[ball.x+i]) ball.y = dune.dunePoints[ball.x+i]-ball.radius;
+			if(ball.y+ball.radius > dune.dunePoints[ball.x-i]) ball.y = dune.dunePoints[ball.x-i]-ball.radius;
+		}
+		double angle = dune.duneAngles[ball.x];
+        double speed = sqrt(ball.dx*ball.dx + ball.dy*ball.dy)*cos(angle);
+		ball.dx = speed*cos(angle);
+		ball.dy = speed*sin(angle);
+		ball.y += ball.dy + 0.5*accel;
+		ball.x += ball.dx;
+    }
+    else{
+      	ball.y += (int) ball.dy + 0.5*accel;
+       	ball.dy += accel;
+		ball.x += ball.dx;
+    }
+
+	if(!in_bounds(ball.x,ball.y)){
+		ball.x = BALL_X;
+		ball.y = 0;
+		ball.dy = sqrt(ball.dx*ball.dx + ball.dy*ball.dy);
+		ball.dx = 0;
+	}
+}
+
+void draw_line(int x0, int y0, int x1, int y1, short int line_color){
+	if (glyph_record) glyph_line(x0, y0, x1, y1, line_color);
+	else solid_line(x0, y0, x1, y1, line_color);
+}
+
+void clear_line(int x0, int y0, int x1, int y1){
+	restore_line(x0, y0, x1, y1, 0);
+}
+
+// the HEX displays are not tied to the frame, so the update waits for idle
+// time, as does laying out the score line the next frame is likely to show
+void display_score(int score){
+	hex_score = (score != hex_shown) ? score : -1;
+	hud.previous = hud.shown;
+	hud.shown = score;
+}
+
+// idle task: drive the HEX displays with the last score
+bool hex_step(void* arg){
+	(void) arg;
+	if (hex_score < 0) return false;
+	int score = hex_score;
+	hex_score = -1;
+	hex_shown = score;
+	// extract the digits
+	int digits[6];
+	for (int i = 0; i < 6; i++){
+		digits[i] = (score % 10);
+		score /= 10;
+	}
+	
+	unsigned char hex_segs[] = {0, 0, 0, 0, 0, 0, 0, 0};
+	unsigned int shift_buffer, nibble;
+	shift_buffer = (digits[5] << 20) | (digits[4] << 16) | (digits[3] << 12) 
+		| (digits[2] << 8) | (digits[1] << 4) | digits[0];
+	
+	for (int i = 0; i < 6; ++i) {
+		nibble = shift_buffer & 0x0000000F; // character is in rightmost nibble
+		hex_segs[i] = seven_seg_decode_table[nibble];
+		shift_buffer = shift_buffer >> 4;
+	}
+	/* drive the hex displays, only the digits that changed are written */
+	dev_shadow_write(SHADOW_HEX3_HEX0, *(int *)(hex_segs));
+	dev_shadow_write(SHADOW_HEX5_HEX4, *(int *)(hex_segs + 4));
+	return true;
+}
+
+#ifdef HOST_BUILD
+unsigned int trace_ns(){
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec*1000000000u + now.tv_nsec;
+}
+#else
+// the private timer counts down from 0xFFFFFFFF at 200 MHz
+unsigned int trace_ns(){
+	return (0xFFFFFFFF - (unsigned int) dev_read(MPCORE_PRIV_TIMER + 4)) * 5;
+}
+#endif
+
+// idle task: note when a keyboard byte first arrives between polls; RI is
+// read from the control register, so the byte stays in the FIFO for the poll
+bool ps2_watch_step(void* arg){
+	(void) arg;
+	if (!__atomic_load_n(&ps2_seen, __ATOMIC_RELAXED) && (dev_read(PS2_BASE + 4) & 0x100))
+		__atomic_store_n(&ps2_seen, trace_ns(), __ATOMIC_RELAXED);
+	return false; // only watches, so it never uses up its budget
+}
+
+// start a sample once the physics step has used the new input
+int latency_begin(unsigned int input){
+	int i = latency_count % LATENCY_SAMPLES;
+	LatencySample* sample = &latency_samples[i];
+	sample->input = input;
+	sample->step = trace_ns();
+	sample->shown = false;
+	latency_count++;
+	return i;
+}
+
+// percentiles of every stage over the samples that reached the screen
+void latency_report(){
+	static unsigned int spans[LATENCY_SAMPLES];
+	const char* stages[] = {"input to step", "step to render", "render to swap", "input to swap"};
+	for(int stage = 0; stage < 4; stage++){
+		int n = 0;
+		for(int i = 0; i < min(latency_count, LATENCY_SAMPLES); i++){
+			LatencySample* sample = &latency_samples[i];
+			if(!sample->shown) continue;
+			unsigned int from[] = {sample->input, sample->step, sample->render, sample->input};
+			unsigned int to[] = {sample->step, sample->render, sample->swap, sample->swap};
+			// insertion sort, there are only a few hundred
+			unsigned int span = to[stage] - from[stage];
+			int j = n++;
+			for(; j > 0 && spans[j-1] > span; j--) spans[j] = spans[j-1];
+			spans[j] = span;
+		}
+		if(n == 0) return;
+		log_printf("latency %s: n %d p50 %u p90 %u p99 %u max %u us\n", stages[stage], n,
+				   spans[n/2]/1000, spans[n*9/10]/1000, spans[n*99/100]/1000, spans[n-1]/1000);
+	}
+}
+
+#ifdef HOST_BUILD
+// the codec, modelled: it plays AUDIO_RATE/60 samples a frame, and is
+// (p+1)/AUDIO_FEEDS of the way through them at feed point p
+typedef struct AudioCodec {
+	short int fifo[AUDIO_FIFO];
+	int head;
+	int count;
+	unsigned long long played;
+} AudioCodec;
+AudioCodec codec;
+
+static int audio_space(int point){
+	unsigned long long due = ((unsigned long long) audio.frames*AUDIO_FEEDS + point + 1) * AUDIO_RATE / (60*AUDIO_FEEDS);
+	for(; codec.played < due; codec.played++){
+		short int sample = 0; // silence once the FIFO runs dry
+		if(codec.count){
+			sample = codec.fifo[codec.head];
+			codec.head = (codec.head + 1) % AUDIO_FIFO;
+			codec.count--;
+		}
+		if(audio_file){
+			fputc(sample & 0xFF, audio_file);
+			fputc((sample >> 8) & 0xFF, audio_file);
+		}
+	}
+	return AUDIO_FIFO - codec.count;
+}
+
+static void audio_write(short int sample){
+	codec.fifo[(codec.head + codec.count) % AUDIO_FIFO] = sample;
+	codec.count++;
+}
+#else
+// the room left for the left channel is in bits 24-31 of the FIFO space
+// register and for the right in bits 16-23
+static int audio_space(int point){
+	(void) point; // only the host's codec model plays up to the point
+	int fifospace = dev_read(AUDIO_BASE + 4);
+	return min((fifospace >> 24) & 0xFF, (fifospace >> 16) & 0xFF);
+}
+
+// both channels play the same sample, in the top bits of the word
+static void audio_write(short int sample){
+	dev_write(AUDIO_BASE + 8, sample * 65536);
+	dev_write(AUDIO_BASE + 12, sample * 65536);
+}
+#endif
+
+// top up the FIFO with what is mixed; the space is read once per burst
+static void audio_fill(int point){
+	int space = audio_space(point);
+	if(space == AUDIO_FIFO) audio.empty++;
+	int ready = audio.mixed*AUDIO_BLOCK - audio.fed;
+	for(int n = min(space, ready); n > 0; n--, audio.fed++)
+		audio_write(audio.blocks[(audio.fed / AUDIO_BLOCK) % AUDIO_BLOCKS][audio.fed % AUDIO_BLOCK]);
+}
+
+static void audio_mix_block(AudioMixer* m){
+	short int* out = m->blocks[m->mixed % AUDIO_BLOCKS];
+	for(int i = 0; i < AUDIO_BLOCK; i++){
+		m->noise = m->noise*1103515245 + 12345;
+		m->windLow += ((int) (m->noise >> 16) - 32768 - m->windLow) >> 3;
+		int sample = (m->windLow * m->windLevel) >> 8;
+		m->tonePhase += m->toneStep;
+		int triangle = m->tonePhase >> 16;
+		triangle = 2*(triangle < 32768 ? triangle : 65535 - triangle) - 32768;
+		sample += (triangle * m->toneLevel) >> 8;
+		if(m->cue > 0){
+			m->cue--;
+			m->cuePhase += m->cueStep;
+			m->cueStep += m->cueSweep;
+			sample += (m->cuePhase & 0x80000000) ? AUDIO_CUE_LEVEL : -AUDIO_CUE_LEVEL;
+		}
+		out[i] = sample > 32767 ? 32767 : (sample < -32768 ? -32768 : sample);
+	}
+	m->mixed++;
+}
+
+// a square wave starting at hz and rising by sweep Hz a second
+static void audio_cue(AudioMixer* m, double hz, double sweep, int samples){
+	m->cue = samples;
+	m->cuePhase = 0;
+	m->cueStep = hz * (4294967296.0/AUDIO_RATE);
+	m->cueSweep = sweep / AUDIO_RATE * (4294967296.0/AUDIO_RATE);
+}
+
+// set the sounds from the frame about to be drawn: wind and a tone that
+// rise with the ball's speed, a chirp as it leaves the dunes and a chime
+// for +2500; only wind and tone stop outside of play
+void audio_update(const GameFrame* frame){
+	unsigned int start = trace_ns();
+	AudioMixer* m = &audio;
+	m->totalNs += m->frameNs;
+	if(m->frameNs > m->maxNs) m->maxNs = m->frameNs;
+	if(m->frameNs > AUDIO_BUDGET_NS) m->over++;
+	m->frameNs = 0;
+	m->frames++;
+	m->point = 0;
+	
+	bool playing = frame->mode == MODE_PLAY;
+	double speed = sqrt(frame->ball.dx*frame->ball.dx + frame->ball.dy*frame->ball.dy);
+	m->windLevel = playing ? min(96, (int) (speed*4)) : 0;
+	m->toneLevel = playing ? 24 : 0;
+	m->toneStep = (110 + 20*fabs(frame->ball.dx)) * (4294967296.0/AUDIO_RATE);
+	bool contact = (frame->stepFlags & STEP_CONTACT) != 0;
+	if(playing && frame->bonus) audio_cue(m, 880, 800, AUDIO_RATE/4);
+	else if(playing && m->contact && !contact) audio_cue(m, 330, 8000, AUDIO_RATE/10);
+	m->contact = contact;
+	m->frameNs += trace_ns() - start;
+}
+
+// the next fixed point of the frame where the FIFO is topped up
+void audio_feed(){
+	unsigned int start = trace_ns();
+	audio_fill(audio.point);
+	if(audio.point < AUDIO_FEEDS-1) audio.point++;
+	audio.frameNs += trace_ns() - start;
+}
+
+// idle task: a feed point of the wait, then mix a block if there is room for
+// one and the frame's audio budget is not used up
+bool audio_step(void* arg){
+	(void) arg;
+	unsigned int start = trace_ns();
+	audio_feed();
+	bool more = false;
+	if(audio.mixed - audio.fed/AUDIO_BLOCK < AUDIO_BLOCKS && audio.frameNs < AUDIO_BUDGET_NS){
+		audio_mix_block(&audio);
+		more = true;
+	}
+#ifdef HOST_BUILD
+	// the board tops up on every poll until the swap, whatever this returns;
+	// the host has no wait, so it asks for the modelled wait's feed points
+	if(audio.point < AUDIO_FEEDS-1) more = true;
+#endif
+	audio.frameNs += trace_ns() - start;
+	return more;
+}
+
+void audio_report(){
+	if(audio.frames == 0) return;
+	log_printf("audio: mean %.1f max %.1f us/frame, %u over %d us, FIFO empty %u\n",
+			   audio.totalNs / 1000.0 / audio.frames, audio.maxNs / 1000.0, audio.over, AUDIO_BUDGET_NS/1000, audio.empty);
+	log_printf("audio: %d Hz, %d feed points a frame\n", AUDIO_RATE, AUDIO_FEEDS);
+}
+
+#ifdef HOST_BUILD
+// there is no keyboard to acknowledge the reset
+void receive_bytes(int n){
+	(void) n;
+}
+#else
+void receive_bytes(int n){
+	int received  = 0;
+	while (received < n) {
+		int PS2_data = dev_read(PS2_BASE); 
+		int RVALID = PS2_data & 0x8000; // extract the RVALID field
+		if (RVALID) {
+			char byte = PS2_data & 0xFF;
+			log_printf("Received %X from keyboard reset\n", byte);
+			received++;
+		}
+	}
+}
+#endif
+
+void space_key_clicked(bool* flag){
+	int PS2_data, RVALID, RAVAIL;
+	bool makeFlag = false;
+	bool breakFlag = false;
+	unsigned char byte; // a plain char is signed on the host, and could never equal 0xF0
+	
+	PS2_data = dev_read(PS2_BASE); 
+	RAVAIL = (PS2_data & 0xFFFF0000) >> 16;
+	RVALID = (PS2_data & 0x8000);
+	if (!RVALID){
+		return;
+	}
+	
+	byte = PS2_data & 0xFF;
+	if (byte == 0x29){
+		makeFlag = true;
+	}
+	else if (byte == 0xF0){
+		breakFlag = true;
+	}
+	
+	for (int i = 0; i < RAVAIL; i++){
+		PS2_data = dev_read(PS2_BASE);
+		byte = PS2_data & 0xFF;
+		if (byte == 0x29){
+			makeFlag = true;
+		}
+		else if (byte == 0xF0){
+			breakFlag = true;
+		}
+	}
+	
+	if (breakFlag){
+		*flag = false;
+	}
+	else if (makeFlag){
+		*flag = true;
+	}
+}
+	
+// write an output register unless it already holds the value
+void dev_shadow_write(int shadow, int value){
+	if (device_shadow_valid[shadow] && device_shadow[shadow] == value){
+		__atomic_fetch_add(&device_stats.skipped, 1, __ATOMIC_RELAXED);
+		return;
+	}
+	device_shadow[shadow] = value;
+	device_shadow_valid[shadow] = true;
+	dev_write(shadow_addr[shadow], value);
+}
+
+void device_report(){
+	if (device_stats.frames == 0) return;
+	log_printf("devices: %.1f reads %.1f writes/frame, %u skipped, %u cached\n",
+			   (double) device_stats.reads / device_stats.frames, (double) device_stats.writes / device_stats.frames,
+			   device_stats.skipped, device_stats.cached);
+}
+
+// read from switches; they only pick the ball colour, so a read every
+// SWITCH_REFRESH frames is plenty
+int read_SW(){
+	if (switch_age == 0) switch_cache = dev_read(SW_BASE);
+	else __atomic_fetch_add(&device_stats.cached, 1, __ATOMIC_RELAXED);
+	switch_age = (switch_age + 1) % SWITCH_REFRESH;
+	return switch_cache;
+}
+
+// the lowest switch that is up picks the colour, and its LED lights up;
+// only worked out again when the switches change
+short int set_ball_color(){
+	static int last = -1;
+	static short int color = RED;
+	int sel = frame_switches;
+	if (sel == last) return color;
+	last = sel;
+	
+	int i = 0;
+	while (sel != 0 && (sel & 0x1) != 1 && (i < 10)){
+		sel /= 2;
+		i++;
+	}
+	if (sel == 0 || i >= 10){
+		color = RED;
+		dev_shadow_write(SHADOW_LEDR, 0);
+	}
+	else{
+		color = ball_colors[i];
+		dev_shadow_write(SHADOW_LEDR, 1 << i);
+	}
+	return color;
+}
+
+// little endian helpers so the trace reads the same on the board and host
+static void put_u16(unsigned char* p, unsigned int v){
+	p[0] = v & 0xFF;
+	p[1] = (v >> 8) & 0xFF;
+}
+
+static void put_u32(unsigned char* p, unsigned int v){
+	put_u16(p, v & 0xFFFF);
+	put_u16(p + 2, v >> 16);
+}
+
+static unsigned int get_u16(unsigned char* p){
+	return p[0] | (p[1] << 8);
+}
+
+static unsigned int get_u32(unsigned char* p){
+	return get_u16(p) | (get_u16(p + 2) << 16);
+}
+
+// write the header when recording, or validate it and take the seed when replaying
+void begin_trace(){
+	trace_frame = 0;
+	if (input_mode == INPUT_RECORD){
+		trace_frames = 0;
+		memcpy(input_trace, "DINP", 4);
+		put_u16(input_trace + 4, TRACE_VERSION);
+		put_u16(input_trace + 6, 0);
+		put_u32(input_trace + 8, terrain_seed);
+		put_u32(input_trace + 12, 0);
+	}
+	else if (input_mode == INPUT_REPLAY){
+		if (memcmp(input_trace, "DINP", 4) || get_u16(input_trace + 4) != TRACE_VERSION){
+			log_printf("input trace has no valid header, playing live input\n");
+			input_mode = INPUT_LIVE;
+			return;
+		}
+		terrain_seed = get_u32(input_trace + 8);
+		trace_frames = min(MAX_TRACE_FRAMES, get_u32(input_trace + 12));
+	}
+}
+
+void poll_switches(){
+	if (input_mode == INPUT_SCRIPT){
+		frame_switches = 0;
+		return;
+	}
+	if (input_mode == INPUT_REPLAY){
+		if (trace_frame < trace_frames){
+			frame_switches = get_u16(input_trace + TRACE_HEADER_SIZE + 2*trace_frame) & ~TRACE_SPACEBAR;
+			return;
+		}
+		// out of frames, carry on with the real inputs
+		input_mode = INPUT_LIVE;
+	}
+	frame_switches = read_SW();
+}
+
+// ends the frame's input, so it is called once per frame after poll_switches
+void poll_spacebar(bool* spacebar){
+	if (input_mode == INPUT_SCRIPT){
+		*spacebar = frames_run == SCRIPT_START || (frames_run > SCRIPT_START && frames_run % SCRIPT_PERIOD < SCRIPT_HOLD);
+		return;
+	}
+	if (input_mode == INPUT_REPLAY){
+		*spacebar = (get_u16(input_trace + TRACE_HEADER_SIZE + 2*trace_frame) & TRACE_SPACEBAR) != 0;
+		trace_frame++;
+		return;
+	}
+	space_key_clicked(spacebar);
+	if (input_mode == INPUT_RECORD){
+		if (trace_frames == MAX_TRACE_FRAMES){
+			input_mode = INPUT_LIVE; // trace is full
+			return;
+		}
+		put_u16(input_trace + TRACE_HEADER_SIZE + 2*trace_frames, (frame_switches & 0x3FF) | (*spacebar ? TRACE_SPACEBAR : 0));
+		trace_frames++;
+		put_u32(input_trace + 12, trace_frames);
+	}
+}
+
+bool game_running(){
+#ifdef HOST_BUILD
+	if (input_mode == INPUT_REPLAY && trace_frame >= trace_frames) return false;
+	if (max_frames > 0 && frames_run >= max_frames) return false;
+	if (__atomic_load_n(&stop_requested, __ATOMIC_RELAXED)) return false;
+#endif
+	return true;
+}
+
+// small LCG so the terrain is the same for a seed on every platform
+int terrain_rand(unsigned int* state){
+	*state = *state*1103515245 + 12345;
+	return (*state >> 16) & 0x7FFF;
+}
+
+#ifdef HOST_BUILD
+bool load_trace(const char* path){
+	FILE* file = fopen(path, "rb");
+	if (!file) return false;
+	size_t size = fread(input_trace, 1, sizeof(input_trace), file);
+	fclose(file);
+	if (size < TRACE_HEADER_SIZE) return false;
+	if (memcmp(input_trace, "DINP", 4) || get_u16(input_trace + 4) != TRACE_VERSION) return false;
+	// frames missing from a truncated file are not replayed
+	if (get_u32(input_trace + 12) > (size - TRACE_HEADER_SIZE)/2)
+		put_u32(input_trace + 12, (size - TRACE_HEADER_SIZE)/2);
+	input_mode = INPUT_REPLAY;
+	return true;
+}
+
+bool save_trace(const char* path){
+	FILE* file = fopen(path, "wb");
+	if (!file) return false;
+	size_t size = TRACE_HEADER_SIZE + 2*trace_frames;
+	bool ok = fwrite(input_trace, 1, size, file) == size;
+	return fclose(file) == 0 && ok;
+}
+#endif
+
+// values that change by about the same amount every frame are predicted to
+// change by that again, the rest to stay the same
+static const bool telemetry_steady[TELEMETRY_FIELDS] = {
+	[TELEMETRY_Y] = true, [TELEMETRY_SCROLL] = true, [TELEMETRY_SCORE] = true
+};
+
+// 7 bits per byte, low bits first, the top bit set on all but the last byte
+static unsigned char* put_varint(unsigned char* p, unsigned int v){
+	while (v >= 0x80){
+		*p++ = (v & 0x7F) | 0x80;
+		v >>= 7;
+	}
+	*p++ = v;
+	return p;
+}
+
+static const unsigned char* get_varint(const unsigned char* p, unsigned int* v){
+	*v = 0;
+	for (int shift = 0; shift < 35; shift += 7){
+		*v |= (*p & 0x7F) << shift;
+		if (!(*p++ & 0x80)) break;
+	}
+	return p;
+}
+
+static unsigned int telemetry_predict(const TelemetryDelta* delta, int i){
+	return (unsigned int) delta->last[i] + (telemetry_steady[i] ? (unsigned int) delta->step[i] : 0);
+}
+
+// a frame is one byte of mode and step flags, a varint mask of the values
+// that missed their prediction, then each miss as a zigzag varint, so small
+// misses of either sign take one byte; returns the bytes written
+int telemetry_encode(unsigned char* out, const TelemetryFrame* frame, TelemetryDelta* delta){
+	unsigned int miss[TELEMETRY_FIELDS];
+	unsigned int mask = 0;
+	for (int i = 0; i < TELEMETRY_FIELDS; i++){
+		int error = (int) ((unsigned int) frame->value[i] - telemetry_predict(delta, i));
+		miss[i] = ((unsigned int) error << 1) ^ (unsigned int) (error >> 31);
+		if (error) mask |= 1 << i;
+		delta->step[i] = (int) ((unsigned int) frame->value[i] - (unsigned int) delta->last[i]);
+		delta->last[i] = frame->value[i];
+	}
+	unsigned char* p = out;
+	*p++ = frame->mode | (frame->flags << 2);
+	p = put_varint(p, mask);
+	for (int i = 0; i < TELEMETRY_FIELDS; i++)
+		if (mask & (1 << i)) p = put_varint(p, miss[i]);
+	return p - out;
+}
+
+// the reverse of telemetry_encode; returns the bytes read
+int telemetry_decode(const unsigned char* in, TelemetryFrame* frame, TelemetryDelta* delta){
+	const unsigned char* p = in;
+	frame->mode = *p & 3;
+	frame->flags = *p++ >> 2;
+	unsigned int mask;
+	p = get_varint(p, &mask);
+	for (int i = 0; i < TELEMETRY_FIELDS; i++){
+		unsigned int miss = 0;
+		if (mask & (1 << i)) p = get_varint(p, &miss);
+		int error = (int) (miss >> 1) ^ -(int) (miss & 1);
+		int value = (int) (telemetry_predict(delta, i) + (unsigned int) error);
+		delta->step[i] = (int) ((unsigned int) value - (unsigned int) delta->last[i]);
+		delta->last[i] = value;
+		frame->value[i] = value;
+	}
+	return p - in;
+}
+
+static unsigned char* telemetry_slot(unsigned int slot){
+	return telemetry + TELEMETRY_HEADER_SIZE + slot*TELEMETRY_CHUNK;
+}
+
+// empty the ring and write its header for the terrain about to be played
+void telemetry_begin(){
+	memset(&telemetry_writer, 0, sizeof(telemetry_writer));
+	memcpy(telemetry, "DTEL", 4);
+	put_u16(telemetry + 4, TELEMETRY_VERSION);
+	put_u16(telemetry + 6, TELEMETRY_CHUNK);
+	put_u32(telemetry + 8, terrain_seed);
+	put_u32(telemetry + 12, 0);
+	// a dump ends at the first chunk without frames
+	for (int slot = 0; slot < TELEMETRY_CHUNKS; slot++) memset(telemetry_slot(slot), 0, TELEMETRY_CHUNK_HEADER);
+}
+
+// append a frame, starting the next chunk when the longest record might not
+// fit; each chunk predicts from zero, so it decodes without the ones before it
+void telemetry_record(TelemetryFrame* frame){
+	TelemetryWriter* writer = &telemetry_writer;
+	frame->frame = writer->frames++;
+	if (writer->chunks == 0 || writer->offset + TELEMETRY_MAX_RECORD > TELEMETRY_CHUNK){
+		unsigned int slot = writer->chunks % TELEMETRY_CHUNKS;
+		unsigned char* chunk = telemetry_slot(slot);
+		put_u32(chunk, frame->frame);
+		put_u16(chunk + 4, 0);
+		put_u16(chunk + 6, 0);
+		writer->chunks++;
+		writer->offset = TELEMETRY_CHUNK_HEADER;
+		memset(&writer->delta, 0, sizeof(writer->delta));
+		// once the ring has wrapped, the chunk after this one is the oldest
+		if (writer->chunks > TELEMETRY_CHUNKS) put_u32(telemetry + 12, (slot + 1) % TELEMETRY_CHUNKS);
+	}
+	unsigned char* chunk = telemetry_slot((writer->chunks - 1) % TELEMETRY_CHUNKS);
+	writer->offset += telemetry_encode(chunk + writer->offset, frame, &writer->delta);
+	// the header is kept current, so a dump taken at any time reads back
+	put_u16(chunk + 4, get_u16(chunk + 4) + 1);
+	put_u16(chunk + 6, writer->offset - TELEMETRY_CHUNK_HEADER);
+}
+
+#ifdef HOST_BUILD
+// 16 bit mono WAV of what the modelled codec plays; the sizes in the
+// header are filled in by audio_finish
+bool audio_output(const char* path){
+	audio_file = fopen(path, "wb");
+	if(!audio_file) return false;
+	unsigned char header[44] = "RIFF\0\0\0\0WAVEfmt ";
+	put_u32(header + 16, 16);
+	put_u16(header + 20, 1); // PCM
+	put_u16(header + 22, 1);
+	put_u32(header + 24, AUDIO_RATE);
+	put_u32(header + 28, 2*AUDIO_RATE);
+	put_u16(header + 32, 2);
+	put_u16(header + 34, 16);
+	memcpy(header + 36, "data", 4);
+	return fwrite(header, 1, sizeof(header), audio_file) == sizeof(header);
+}
+
+bool audio_finish(){
+	if(!audio_file) return true;
+	unsigned char size[4];
+	long end = ftell(audio_file);
+	put_u32(size, end - 8);
+	fseek(audio_file, 4, SEEK_SET);
+	fwrite(size, 1, 4, audio_file);
+	put_u32(size, end - 44);
+	fseek(audio_file, 40, SEEK_SET);
+	fwrite(size, 1, 4, audio_file);
+	bool ok = !ferror(audio_file);
+	ok = fclose(audio_file) == 0 && ok;
+	audio_file = NULL;
+	return ok;
+}
+
+bool telemetry_output(const char* path){
+	telemetry_file = fopen(path, "wb");
+	return telemetry_file != NULL;
+}
+
+// write one chunk to the file, after the header if it is the first; errors
+// stay on the stream for telemetry_finish
+static void telemetry_write(unsigned int chunk){
+	if (ftell(telemetry_file) == 0) fwrite(telemetry, 1, TELEMETRY_HEADER_SIZE, telemetry_file);
+	fwrite(telemetry_slot(chunk % TELEMETRY_CHUNKS), 1, TELEMETRY_CHUNK, telemetry_file);
+}
+
+// idle task: write the oldest finished chunk to the file; the file is never
+// wrapped, so its oldest chunk stays at 0
+bool telemetry_step(void* arg){
+	(void) arg;
+	TelemetryWriter* writer = &telemetry_writer;
+	if (!telemetry_file || writer->written + 1 >= writer->chunks) return false;
+	if (writer->chunks - writer->written > TELEMETRY_CHUNKS){
+		writer->lost += writer->chunks - TELEMETRY_CHUNKS - writer->written;
+		writer->written = writer->chunks - TELEMETRY_CHUNKS;
+	}
+	telemetry_write(writer->written++);
+	return true;
+}
+
+// write the chunks still in the ring, including the one being filled
+bool telemetry_finish(){
+	TelemetryWriter* writer = &telemetry_writer;
+	if (!telemetry_file) return true;
+	while (telemetry_step(NULL));
+	if (writer->written < writer->chunks) telemetry_write(writer->written++);
+	else if (ftell(telemetry_file) == 0) fwrite(telemetry, 1, TELEMETRY_HEADER_SIZE, telemetry_file);
+	if (writer->lost) log_printf("telemetry: %u chunks lost\n", writer->lost);
+	bool ok = !ferror(telemetry_file);
+	ok = fclose(telemetry_file) == 0 && ok;
+	telemetry_file = NULL;
+	return ok;
+}
+#endif
+
+void draw_DUNE(short int color){
+	//letters start at x=56 to 264
+    //letters are 42 wide and 82 tall, with 5 blank each side, thickness of 7
+    //letters are drawn from y = 24 to y = 106, middle is at 66
+    
+    //draw DUNE letters
+    //letter D, goes from x =[61,103]
+	for(int y = 0; y <= 42; y++){
+         int x = logo_outer_span[y];
+         draw_line(60, 65+y, 60+x , 65+y, color);
+         draw_line(60, 65-y, 60+x , 65-y, color);
+	}
+    for(int y = 0; y <= 28; y++){
+		 int x = logo_inner_span[y];
+         clear_line(67, 65+y, 67+x, 65+y);
+         clear_line(67, 65-y, 67+x, 65-y);
+	}
+    //letter U, goes from x = [113,155]
+    for(int x = 113; x <= 120; x++){
+         draw_line(x, 24, x, 106, color);
+    } 
+    for(int x = 121; x < 148; x++){
+         draw_line(x, 99, x, 106, color);
+    }
+	for(int x = 148; x <= 155; x++){
+         draw_line(x, 24, x, 106, color);
+    }
+    //letter N x = [165, 207]
+    for(int x = 165; x <= 172; x++){
+         draw_line(x, 24, x, 106, color);
+    }
+    for(int i = 0; i<=7; i++){
+	     draw_line(173,24+i, 200,99+i, color);
+    }
+    for(int x = 200; x <= 207; x++){
+         draw_line(x, 24, x, 106, color);
+    }
+    //letter E x= [217, 259]
+    for(int x = 217; x <= 224; x++){
+         draw_line(x, 24, x, 106, color);
+    }
+    for(int y = 24; y<=31; y++){
+     	draw_line(225, y, 259, y, color);
+		draw_line(225, y+38, 259, y+38, color);
+        draw_line(225, y+75, 259, y+75, color);
+	}
+}
+
+void draw_P(int x, int y, short int color){
+	draw_line(x, y, x, y+10, color);
+	draw_line(x, y, x+5, y, color);
+	draw_line(x, y+5, x+5, y+5, color);
+	x+=5;
+	draw_line(x, y, x, y+5, color);
+}
+
+void draw_R(int x, int y, short int color){
+	draw_line(x, y, x, y+10, color);
+	draw_line(x, y, x+5, y, color);
+	draw_line(x, y+5, x+5, y+5, color);
+	draw_line(x+5, y, x+5, y+5, color);
+	draw_line(x, y+5, x+5, y+10, color);
+}
+
+void draw_E(int x, int y, short int color){
+	draw_line(x, y, x, y+10, color);
+	draw_line(x, y, x+5, y, color);
+	draw_line(x, y+5, x+5, y+5, color);
+	draw_line(x, y+10, x+5, y+10, color);
+}
+
+//same for S and 5
+void draw_S(int x, int y, short int color){
+	draw_line(x, y, x, y+5, color);
+	draw_line(x, y, x+5, y, color);
+	draw_line(x, y+5, x+5, y+5, color);
+	draw_line(x, y+10, x+5, y+10, color);
+	draw_line(x+5, y+5, x+5, y+10, color);
+}
+
+void draw_A(int x, int y, short int color){
+	draw_line(x, y, x, y+10, color);
+	draw_line(x+5, y, x+5, y+10, color);
+	draw_line(x, y, x+5, y, color);
+	draw_line(x, y+5, x+5, y+5, color);
+}
+
+void draw_C(int x, int y, short int color){
+	draw_line(x, y, x, y+10, color);
+	draw_line(x, y, x+5, y, color);
+	draw_line(x, y+10, x+5, y+10, color);
+}
+
+void draw_T(int x, int y, short int color){
+	draw_line(x, y, x+5, y, color);
+	draw_line(x+2, y, x+2, y+10, color);
+}
+
+//draw 0 and O
+void draw_O(int x, int y, short int color){
+	draw_line(x, y, x, y+10, color);
+	draw_line(x, y, x+5, y, color);
+	draw_line(x, y+10, x+5, y+10, color);
+	draw_line(x+5, y, x+5, y+10, color);
+}
+
+void draw_quote(int x, int y, short int color){
+	draw_line(x+1, y, x+1, y+2, color);
+	draw_line(x+3, y, x+3, y+2, color);
+}
+
+void draw_I(int x, int y, short int color){
+	draw_line(x+2, y, x+2, y+10,color);
+	draw_line(x, y, x+5, y, color);
+	draw_line(x, y+10, x+5, y+10, color);
+}
+
+void draw_N(int x, int y, short int color){
+	draw_line(x, y, x, y+10, color);
+	draw_line(x+5, y, x+5, y+10, color);
+	draw_line(x, y, x+5, y+10, color);
+}
+
+void draw_G(int x, int y, short int color){
+	draw_line(x, y, x, y+10, color);
+	draw_line(x, y, x+5, y, color);
+	draw_line(x+3, y+5, x+5, y+5, color);
+	draw_line(x, y+10, x+5, y+10, color);
+	draw_line(x+5, y+5, x+5, y+10, color);
+}
+
+void draw_M(int x, int y, short int color){
+	draw_line(x, y, x, y+10, color);
+	draw_line(x+5, y, x+5, y+10, color);
+	draw_line(x, y, x+2, y+5, color);
+	draw_line(x+3, y+5, x+5, y, color);
+}
+
+void draw_V(int x, int y, short int color){
+	draw_line(x, y, x+2, y+10, color);
+	draw_line(x+3, y+10, x+5, y, color);
+}
+
+void draw_two_points(int x, int y, short int color){
+	draw_line(x+1, y+2, x+1, y+4, color);
+	draw_line(x+2, y+2, x+2, y+4, color);
+	draw_line(x+1, y+6, x+1, y+8, color);
+	draw_line(x+2, y+6, x+2, y+8, color);
+}
+	
+void draw_1(int x, int y, short int color){
+	draw_line(x+2, y, x+2, y+10,color);
+	draw_line(x, y+2, x+2, y,color);
+	draw_line(x, y+10, x+5, y+10, color);
+}
+
+void draw_2(int x, int y, short int color){
+	draw_line(x+5, y, x+5, y+5, color);
+	draw_line(x, y, x+5, y, color);
+	draw_line(x, y+5, x+5, y+5, color);
+	draw_line(x, y+10, x+5, y+10, color);
+	draw_line(x, y+5, x, y+10, color);
+}
+
+void draw_3(int x, int y, short int color){
+	draw_line(x+5, y, x+5, y+10, color);
+	draw_line(x, y, x+5, y, color);
+	draw_line(x, y+5, x+5, y+5, color);
+	draw_line(x, y+10, x+5, y+10, color);
+}
+
+void draw_4(int x, int y, short int color){
+	draw_line(x+5, y, x+5, y+10, color);
+	draw_line(x, y, x, y+5, color);
+	draw_line(x, y+5, x+5, y+5, color);
+}
+
+void draw_6(int x, int y, short int color){
+	draw_line(x, y, x, y+10, color);
+	draw_line(x, y, x+5, y, color);
+	draw_line(x, y+5, x+5, y+5, color);
+	draw_line(x, y+10, x+5, y+10, color);
+	draw_line(x+5, y+5, x+5, y+10, color);
+}
+
+void draw_7(int x, int y, short int color){
+	draw_line(x+5, y, x+5, y+10, color);
+	draw_line(x, y, x, y+5, color);
+	draw_line(x, y, x+5, y, color);
+}
+
+void draw_8(int x, int y, short int color){
+	draw_line(x, y, x, y+10, color);
+	draw_line(x+5, y, x+5, y+10, color);
+	draw_line(x, y, x+5, y, color);
+	draw_line(x, y+5, x+5, y+5, color);
+	draw_line(x, y+10, x+5, y+10, color);
+}
+
+void draw_9(int x, int y, short int color){
+	draw_line(x, y, x, y+5, color);
+	draw_line(x+5, y, x+5, y+10, color);
+	draw_line(x, y, x+5, y, color);
+	draw_line(x, y+5, x+5, y+5, color);
+	draw_line(x, y+10, x+5, y+10, color);
+}
+
+void draw_press_space_to_start(int x, int y, short int color){
+	draw_P(x, y, color);
+	x+=7;
+	draw_R(x, y, color);
+	x+=7;
+	draw_E(x, y, color);
+	x+=7;
+	draw_S(x, y, color);
+	x+=7;
+	draw_S(x, y, color);
+	x+=14;
+	draw_quote(x, y, color);
+	x+=7;
+	draw_S(x, y, color);
+	x+=7;
+	draw_P(x, y, color);
+	x+=7;
+	draw_A(x, y, color);
+	x+=7;
+	draw_C(x, y, color);
+	x+=7;
+	draw_E(x, y, color);
+	x+=7;
+	draw_quote(x, y, color);
+	x+=14;
+	draw_T(x, y, color);
+	x+=7;
+	draw_O(x, y, color);
+	x+=14;
+	draw_S(x, y, color);
+	x+=7;
+	draw_T(x, y, color);
+	x+=7;
+	draw_A(x, y, color);
+	x+=7;
+	draw_R(x, y, color);
+	x+=7;
+	draw_T(x, y, color);
+	x+=7;
+}
+
+void draw_game_over(int x, int y, short int color){
+	draw_G(x,y,color);
+	x+=7;
+	draw_A(x,y,color);
+	x+=7;
+	draw_M(x,y,color);
+	x+=7;
+	draw_E(x,y,color);
+	x+=14;
+	draw_O(x,y,color);
+	x+=7;
+	draw_V(x,y,color);
+	x+=7;
+	draw_E(x,y,color);
+	x+=7;
+	draw_R(x,y,color);
+	x+=7;
+}
+
+void draw_plus(int x, int y, short int color){
+	draw_line(x, y+3, x+5, y+3, color);
+	draw_line(x+3, y+1, x+3, y+6, color);
+}
+
+// strokes of each cached glyph, indexed as its mask
+static void (*const glyph_strokes[GLYPHS])(int x, int y, short int color) = {
+	draw_O, draw_1, draw_2, draw_3, draw_4, draw_S, draw_6, draw_7, draw_8, draw_9,
+	draw_two_points, draw_E, draw_R, draw_C, draw_plus
+};
+
+// idle task: cache the next glyph's mask by recording its strokes at (0, 0)
+bool glyph_step(void* arg){
+	Hud* hud = arg;
+	if (hud->cached == GLYPHS) return false;
+	unsigned char* mask = hud->glyphs[hud->cached];
+	memset(mask, 0, GLYPH_H);
+	glyph_record = mask;
+	glyph_strokes[hud->cached](0, 0, WHITE);
+	glyph_record = NULL;
+	hud->cached++;
+	return true;
+}
+
+// a glyph from its mask, or from its strokes until the mask is cached
+void draw_glyph(int glyph, int x, int y, short int color){
+	if (glyph >= hud.cached){
+		glyph_strokes[glyph](x, y, color);
+		return;
+	}
+	for (int row = 0; row < GLYPH_H; row++){
+		if (!IN_BAND(y + row)) continue;
+		short int* pixels = PIXEL_ADDR(x, y + row);
+		for (unsigned int bits = hud.glyphs[glyph][row]; bits; bits &= bits - 1)
+			pixels[__builtin_ctz(bits)] = color; // lowest lit pixel left
+	}
+}
+
+// the glyphs of the score line from right to left: the digits, then ":EROCS"
+static int score_glyphs(int points, int* glyphs){
+	int count = 0;
+	do{
+		glyphs[count++] = points%10;
+		points = points/10;
+	} while(points != 0);
+	glyphs[count++] = GLYPH_COLON;
+	glyphs[count++] = GLYPH_E;
+	glyphs[count++] = GLYPH_R;
+	glyphs[count++] = 0; // O
+	glyphs[count++] = GLYPH_C;
+	glyphs[count++] = 5; // S
+	return count;
+}
+
+// idle task: lay out the score line for the last score plus its last change,
+// which is what the next frame shows unless the ball's speed or the run changed
+bool hud_step(void* arg){
+	Hud* hud = arg;
+	int next = hud->shown + (hud->shown - hud->previous);
+	if (hud->cached < GLYPHS || hud->previous < 0 || next < 0 || next == hud->score) return false;
+	int glyphs[HUD_GLYPHS];
+	int count = score_glyphs(next, glyphs);
+	hud->left = HUD_X - (count-1)*GLYPH_ADVANCE;
+	hud->words = ((count-1)*GLYPH_ADVANCE + GLYPH_W + 31)/32;
+	memset(hud->line, 0, sizeof(hud->line));
+	for (int i = 0; i < count; i++){
+		int offset = HUD_X - i*GLYPH_ADVANCE - hud->left;
+		int word = offset/32, shift = offset%32;
+		for (int row = 0; row < GLYPH_H; row++){
+			unsigned int bits = hud->glyphs[glyphs[i]][row];
+			hud->line[row][word] |= bits << shift;
+			if (shift > 32 - GLYPH_W) hud->line[row][word+1] |= bits >> (32 - shift); // straddles two words
+		}
+	}
+	hud->score = next;
+	return true;
+}
+
+void draw_score(int points){
+	if (points == hud.score){
+		// laid out in idle time
+		for (int row = 0; row < GLYPH_H; row++){
+			if (!IN_BAND(HUD_Y + row)) continue;
+			short int* pixels = PIXEL_ADDR(hud.left, HUD_Y + row);
+			for (int word = 0; word < hud.words; word++)
+				for (unsigned int bits = hud.line[row][word]; bits; bits &= bits - 1)
+					pixels[32*word + __builtin_ctz(bits)] = WHITE;
+		}
+		return;
+	}
+	int glyphs[HUD_GLYPHS];
+	int count = score_glyphs(points, glyphs);
+	for (int i = 0; i < count; i++) draw_glyph(glyphs[i], HUD_X - i*GLYPH_ADVANCE, HUD_Y, WHITE);
+}
+
+typedef struct GameOverScreen {
+	const Ball* ball;
+	Dune* dune;
+	int points, frames;
+} GameOverScreen;
+
+static void game_over_pass(void* arg){
+	GameOverScreen* screen = arg;
+	background_pass(NULL);
+	draw_line(0, SCORE_LINE_Y, RESOLUTION_X-1, SCORE_LINE_Y, WHITE);
+	fill_ball(screen->ball);
+	dune_pass(screen->dune);
+	draw_game_over(130, 40,WHITE);
+	if (screen->frames % 2 == 1) draw_press_space_to_start(83, 80, WHITE);
+	draw_score(screen->points);
+}
+
+// the whole screen is redrawn, one band per thread
+void draw_game_over_screen(Ball* ball, Dune* dune, int points, int frames){
+	// update previous ball position once, outside the bands
+	ball->x2 = ball->x1;
+	ball->y2 = ball->y1;
+	ball->x1 = ball->x;
+	ball->y1 = ball->y;
+	GameOverScreen screen = {ball, dune, points, frames};
+	raster_parallel(game_over_pass, &screen);
+}
+
+void draw_2500(int x, int y, short int color){
+	// the plus sign is always white
+	draw_glyph(GLYPH_PLUS, x, y, WHITE);
+	x+=GLYPH_ADVANCE;
+	draw_glyph(2, x, y, color);
+	x+=GLYPH_ADVANCE;
+	draw_glyph(5, x, y, color);
+	x+=GLYPH_ADVANCE;
+	draw_glyph(0, x, y, color);
+	x+=GLYPH_ADVANCE;
+	draw_glyph(0, x, y, color);
+}
+	
+
+
+
+	
+
+
+
+#ifdef HOST_BUILD
+/* Host build tools */
+
+#define BENCH_TIME_NS 20000000.0 // run each case for at least this long
+#define BENCH_SENTINEL 0x0821 // colour no primitive draws, used to count pixels
+
+double now_ns(){
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec*1e9 + t.tv_nsec;
+}
+
+void fill_sentinel(){
+	for (int y = 0; y < RESOLUTION_Y; y++)
+		solid_horizontal(0, RESOLUTION_X-1, y, BENCH_SENTINEL);
+}
+
+// pixels touched since fill_sentinel, each pixel counted once
+int count_written(){
+	int count = 0;
+	for (int y = 0; y < RESOLUTION_Y; y++)
+		for (int x = 0; x < RESOLUTION_X; x++)
+			if (*PIXEL_ADDR(x, y) != BENCH_SENTINEL) count++;
+	return count;
+}
+
+void bench_report(FILE* out, const char* primitive, int parameter, long calls, double elapsed, int pixels){
+	double per_call = elapsed / calls;
+	fprintf(out, "%s,%d,%ld,%.1f,%d,%.3f\n", primitive, parameter, calls, per_call, pixels, pixels ? per_call / pixels : 0.0);
+}
+
+// time a drawing call; the pixel count comes from one call on a sentinel frame
+#define BENCH(out, primitive, parameter, call) do { \
+	fill_sentinel(); \
+	call; \
+	int pixels_ = count_written(); \
+	long calls_ = 0; \
+	double start_ = now_ns(), elapsed_; \
+	do { \
+		for (int rep_ = 0; rep_ < 16; rep_++){ call; } \
+		calls_ += 16; \
+		elapsed_ = now_ns() - start_; \
+	} while (elapsed_ < BENCH_TIME_NS); \
+	bench_report(out, primitive, parameter, calls_, elapsed_, pixels_); \
+} while (0)
+
+// every drawing primitive over a sweep of its parameters, as CSV
+void bench_raster(FILE* out){
+	pixel_buffer_start = SDRAM_BASE;
+	fprintf(out, "primitive,parameter,calls,ns_per_call,pixels,ns_per_pixel\n");
+	
+	// lines of length 100 from the centre, parameter is the angle in degrees
+	for (int angle = 0; angle < 180; angle += 15){
+		int x1 = 160 + (int) round(100*cos(angle*PI/180));
+		int y1 = 120 - (int) round(100*sin(angle*PI/180));
+		BENCH(out, "draw_line", angle, draw_line(160, 120, x1, y1, WHITE));
+		BENCH(out, "clear_line", angle, clear_line(160, 120, x1, y1));
+	}
+	
+	int radii[] = {1, 2, BALL_R, 5, 8, 12, 20};
+	for (int i = 0; i < (int) (sizeof(radii)/sizeof(radii[0])); i++){
+		Ball ball = {.x = 160, .y = 120, .color = RED, .radius = radii[i], .x1 = 160, .y1 = 120, .x2 = 160, .y2 = 120};
+		BENCH(out, "draw_ball", radii[i], draw_ball(&ball));
+		BENCH(out, "clear_ball", radii[i], clear_ball(&ball));
+	}
+	
+	for (int h = MIN_ARROW_HEIGHT; h <= MAX_ARROW_HEIGHT; h += 10){
+		Arrow arrow = {.x = BALL_X, .y = 5, .h = h, .h1 = h, .h2 = h, .color = WHITE};
+		BENCH(out, "draw_isosceles_triangle", h, draw_isosceles_triangle(h/2, h/2, BALL_X, 5, WHITE));
+		BENCH(out, "draw_arrow", h, draw_arrow(&arrow));
+		BENCH(out, "clear_arrow", h, clear_arrow(&arrow));
+	}
+	
+	// terrain from the default seed; the history is two frames of scrolling behind
+	int points[TERRAIN_STORE];
+	double angles[TERRAIN_STORE];
+	double heights[NUM_DUNES];
+	build_terrain(DEFAULT_TERRAIN_SEED, points, angles, heights);
+	Dune dune;
+	for (int speed = 1; speed <= MAX_SPEED; speed += (speed == 1) ? 4 : 5){
+		dune.dunePoints = points + 2*speed;
+		dune.duneAngles = angles + 2*speed;
+		dune.dunePoints2 = points;
+		BENCH(out, "clear_running_dune", speed, clear_running_dune(&dune));
+	}
+	BENCH(out, "draw_dune", 0, draw_dune(&dune));
+	BENCH(out, "draw_dune_slice", 2*BALL_R+1, draw_dune_slice(&dune, BALL_X-BALL_R, BALL_X+BALL_R));
+	BENCH(out, "draw_background", 0, draw_background());
+	BENCH(out, "draw_sky", 0, draw_sky());
+	BENCH(out, "black_screen", 0, black_screen());
+	static FrameSnapshot snapshot;
+	save_frame(&snapshot, SDRAM_BASE);
+	BENCH(out, "restore_frame", 0, restore_frame(&snapshot));
+	Ball ball = {.x = BALL_X, .y = 150, .color = RED, .radius = BALL_R, .x1 = BALL_X, .y1 = 150, .x2 = BALL_X, .y2 = 150};
+	BENCH(out, "draw_game_over_screen", 0, draw_game_over_screen(&ball, &dune, 123456, 1));
+	BENCH(out, "clear_rectangle", 0, clear_rectangle(RESOLUTION_X-92, 5, RESOLUTION_X-4, 15));
+	
+	// glyphs
+	BENCH(out, "draw_DUNE", 0, draw_DUNE(WHITE));
+	BENCH(out, "draw_press_space_to_start", 0, draw_press_space_to_start(83, 120, WHITE));
+	BENCH(out, "draw_game_over", 0, draw_game_over(130, 40, WHITE));
+	BENCH(out, "draw_2500", 0, draw_2500(X_2500, Y_2500, WHITE));
+	int scores[] = {0, 7, 1234, 999999};
+	for (int i = 0; i < (int) (sizeof(scores)/sizeof(scores[0])); i++){
+		BENCH(out, "draw_score", scores[i], draw_score(scores[i]));
+	}
+	// the same from the glyph masks the idle tasks cache, then from score
+	// lines laid out ahead of time
+	while (glyph_step(&hud));
+	BENCH(out, "draw_2500_cached", 0, draw_2500(X_2500, Y_2500, WHITE));
+	for (int i = 0; i < (int) (sizeof(scores)/sizeof(scores[0])); i++){
+		BENCH(out, "draw_score_cached", scores[i], draw_score(scores[i]));
+	}
+	for (int i = 0; i < (int) (sizeof(scores)/sizeof(scores[0])); i++){
+		hud.previous = hud.shown = scores[i];
+		hud_step(&hud);
+		BENCH(out, "draw_score_laid_out", scores[i], draw_score(scores[i]));
+	}
+}
+
+#define BENCH_SEEDS 8
+#define BENCH_PATTERNS 4
+const char* bench_pattern_names[BENCH_PATTERNS] = {"released", "held", "script", "random"};
+
+// spacebar for a step of an input pattern
+bool bench_spacebar(int pattern, long step, unsigned int* rng){
+	if (pattern == 0) return false;
+	if (pattern == 1) return true;
+	if (pattern == 2) return step % SCRIPT_PERIOD < SCRIPT_HOLD;
+	*rng = *rng*1103515245 + 12345;
+	return (*rng >> 16) & 1;
+}
+
+// physics throughput over several seeded terrains for each input pattern,
+// then a second timed pass splitting the cost of contact and airborne steps
+void bench_physics(FILE* out, long steps){
+	static int points[BENCH_SEEDS][TERRAIN_STORE];
+	static double angles[BENCH_SEEDS][TERRAIN_STORE];
+	static double heights[BENCH_SEEDS][NUM_DUNES];
+	static World worlds[BENCH_SEEDS];
+	for (int seed = 0; seed < BENCH_SEEDS; seed++){
+		build_terrain(seed + 1, points[seed], angles[seed], heights[seed]);
+	}
+	// cost of reading the clock, taken off the per step timings
+	double start = now_ns();
+	for (int i = 0; i < 1000; i++) now_ns();
+	double timer_ns = (now_ns() - start) / 1001;
+	
+	fprintf(out, "pattern,steps,steps_per_sec,crashes,contact_steps,airborne_steps,ns_contact,ns_airborne\n");
+	for (int pattern = 0; pattern < BENCH_PATTERNS; pattern++){
+		long per_seed = steps / BENCH_SEEDS;
+		long crashes = 0;
+		unsigned int rng = 1;
+		start = now_ns();
+		for (int seed = 0; seed < BENCH_SEEDS; seed++){
+			reset_world(&worlds[seed], points[seed], angles[seed], heights[seed]);
+			for (long step = 0; step < per_seed; step++){
+				if (physics_step(&worlds[seed], bench_spacebar(pattern, step, &rng)) & STEP_CRASH){
+					reset_world(&worlds[seed], points[seed], angles[seed], heights[seed]);
+					crashes++;
+				}
+			}
+		}
+		double elapsed = now_ns() - start;
+		
+		long count[2] = {0, 0}; // airborne, contact
+		double total[2] = {0, 0};
+		rng = 1;
+		for (int seed = 0; seed < BENCH_SEEDS; seed++){
+			reset_world(&worlds[seed], points[seed], angles[seed], heights[seed]);
+			for (long step = 0; step < per_seed; step++){
+				bool spacebar = bench_spacebar(pattern, step, &rng);
+				double t = now_ns();
+				int result = physics_step(&worlds[seed], spacebar);
+				t = now_ns() - t - timer_ns;
+				count[result & STEP_CONTACT] += 1;
+				total[result & STEP_CONTACT] += t;
+				if (result & STEP_CRASH) reset_world(&worlds[seed], points[seed], angles[seed], heights[seed]);
+			}
+		}
+		fprintf(out, "%s,%ld,%.0f,%ld,%ld,%ld,%.1f,%.1f\n", bench_pattern_names[pattern], per_seed*BENCH_SEEDS,
+				per_seed*BENCH_SEEDS / (elapsed*1e-9), crashes, count[1], count[0],
+				count[1] ? total[1]/count[1] : 0.0, count[0] ? total[0]/count[0] : 0.0);
+	}
+}
+#define BENCH_RIDER_FRAMES 300
+
+// cost of the batch update and of clearing and drawing for growing rider counts
+void bench_riders(FILE* out){
+	static int points[TERRAIN_STORE];
+	static double angles[TERRAIN_STORE];
+	static double heights[NUM_DUNES];
+	static World world;
+	static Riders bench;
+	build_terrain(DEFAULT_TERRAIN_SEED, points, angles, heights);
+	pixel_buffer_start = SDRAM_BASE;
+	
+	fprintf(out, "riders,frames,ns_step,ns_step_per_rider,ns_render,ns_render_per_rider\n");
+	int counts[] = {1, 8, 32, 128, 256, MAX_RIDERS};
+	for(int c = 0; c < (int) (sizeof(counts)/sizeof(counts[0])); c++){
+		int n = counts[c];
+		reset_world(&world, points, angles, heights);
+		reset_riders(&bench, n);
+		unsigned int rng = 1;
+		double step_ns = 0, render_ns = 0;
+		for(int frame = 0; frame < BENCH_RIDER_FRAMES; frame++){
+			// the player holds space so the camera keeps moving
+			physics_step(&world, true);
+			for(int i = 0; i < n; i++){
+				rng = rng*1103515245 + 12345;
+				bench.spacebar[i] = (rng >> 16) & 1;
+			}
+			double t = now_ns();
+			riders_step(&bench, &world);
+			step_ns += now_ns() - t;
+			
+			t = now_ns();
+			clear_riders(&bench, &world.dune);
+			draw_riders(&bench, world.currentX);
+			render_ns += now_ns() - t;
+		}
+		step_ns /= BENCH_RIDER_FRAMES;
+		render_ns /= BENCH_RIDER_FRAMES;
+		fprintf(out, "%d,%d,%.0f,%.1f,%.0f,%.1f\n", n, BENCH_RIDER_FRAMES, step_ns, step_ns/n, render_ns, render_ns/n);
+	}
+}
+
+// worst case frames: each scenario forces one expensive state before every
+// frame, then plays the frame through the real pipeline and times its phases
+#define BENCH_PHASES 4
+#define BENCH_BONUS_PERIOD (FRAMES_2500 + 8) // +2500 shown, then cleared
+#define BENCH_GAME_OVER_PERIOD 12 // frames of play, game over and restart
+const char* bench_phase_names[BENCH_PHASES] = {"step", "render", "present", "frame"};
+
+// keep the ball in the air so the run never crashes by itself
+static void bench_fly(Game* game, double dx, int y){
+	if(game->mode == MODE_GAME_OVER) start_run(game, false);
+	game->world.ball.dx = dx;
+	game->world.ball.dy = 0;
+	game->world.ball.y = y;
+}
+
+// above the top of the screen, so the arrow is drawn at a changing height
+static void force_arrow(Game* game, int frame){
+	bench_fly(game, 10, -game->world.ball.radius - 4 - 2*(frame % 40));
+}
+
+// every dune column changes and the far layers scroll their furthest
+static void force_max_speed(Game* game, int frame){
+	(void) frame;
+	bench_fly(game, MAX_SPEED, 100);
+}
+
+// the ball crossed the score line on the last step
+static void force_bonus(Game* game, int frame){
+	bench_fly(game, 10, 100);
+	if(frame % BENCH_BONUS_PERIOD == 0) game->bonus = true;
+}
+
+// the top score ends the run through the usual crash path, the game over
+// screen is shown, then space restarts from the saved frames
+static void force_game_over(Game* game, int frame){
+	int step = frame % BENCH_GAME_OVER_PERIOD;
+	if(game->mode != MODE_PLAY) return;
+	bench_fly(game, 10, 100);
+	if(step == 4) game->score = 999999;
+}
+
+typedef struct FrameScenario {
+	const char* name;
+	bool play; // start a run, or stay on the title screen
+	void (*force)(Game* game, int frame); // state set before each frame, NULL for none
+	int pressEvery; // space is down on the last frame of each period, 0 for never
+} FrameScenario;
+
+FrameScenario bench_scenarios[] = {
+	{"title", false, NULL, 0},
+	{"arrow", true, force_arrow, 0},
+	{"max_speed", true, force_max_speed, 0},
+	{"bonus", true, force_bonus, 0},
+	{"game_over", true, force_game_over, BENCH_GAME_OVER_PERIOD},
+};
+
+// p50, p99 and max of each phase of every frame, for each scenario
+void bench_frames(FILE* out, int frames){
+	static unsigned int spans[BENCH_PHASES][MAX_TRACE_FRAMES];
+	frames = max(1, min(frames, MAX_TRACE_FRAMES));
+	attract_delay = 1 << 30; // the title scenario must not start the autopilot
+	particle_budget_ns = 0; // the same grains on every machine
+	log_file = stderr; // keep the run over lines out of the table
+	setup_devices();
+	
+	fprintf(out, "scenario,phase,frames,p50_us,p99_us,max_us\n");
+	for(int s = 0; s < (int) (sizeof(bench_scenarios)/sizeof(bench_scenarios[0])); s++){
+		FrameScenario* scenario = &bench_scenarios[s];
+		// the spacebar comes from a made up trace, so every run is the same
+		memcpy(input_trace, "DINP", 4);
+		put_u16(input_trace + 4, TRACE_VERSION);
+		put_u16(input_trace + 6, 0);
+		put_u32(input_trace + 8, DEFAULT_TERRAIN_SEED);
+		put_u32(input_trace + 12, frames);
+		for(int i = 0; i < frames; i++){
+			bool press = scenario->pressEvery && i % scenario->pressEvery == scenario->pressEvery-1;
+			put_u16(input_trace + TRACE_HEADER_SIZE + 2*i, press ? TRACE_SPACEBAR : 0);
+		}
+		input_mode = INPUT_REPLAY;
+		ghost_count = 0;
+		start_game(&game);
+		start_renderer(&renderer, &game.world.ball);
+		restore_initial_frames();
+		if(scenario->play) start_run(&game, false);
+		
+		for(int i = 0; i < frames; i++){
+			if(scenario->force) scenario->force(&game, i);
+			unsigned int t0 = trace_ns();
+			GameFrame* frame = queue_reserve(&frame_queue);
+			prepare_frame(&game, frame);
+			queue_publish(&frame_queue);
+			unsigned int t1 = trace_ns();
+			render_frame(&renderer, queue_front(&frame_queue));
+			queue_release(&frame_queue);
+			unsigned int t2 = trace_ns();
+			advance_game(&game);
+			unsigned int t3 = trace_ns();
+			present_frame(&renderer);
+			unsigned int t4 = trace_ns();
+			frames_run++;
+			
+			unsigned int span[BENCH_PHASES] = {(t1 - t0) + (t3 - t2), t2 - t1, t4 - t3, t4 - t0};
+			for(int phase = 0; phase < BENCH_PHASES; phase++){
+				// insertion sort, the frames mostly cost about the same
+				int j = i;
+				for(; j > 0 && spans[phase][j-1] > span[phase]; j--) spans[phase][j] = spans[phase][j-1];
+				spans[phase][j] = span[phase];
+			}
+		}
+		for(int phase = 0; phase < BENCH_PHASES; phase++){
+			unsigned int* sorted = spans[phase];
+			fprintf(out, "%s,%s,%d,%.1f,%.1f,%.1f\n", scenario->name, bench_phase_names[phase], frames,
+					sorted[frames/2]/1000.0, sorted[frames*99/100]/1000.0, sorted[frames-1]/1000.0);
+		}
+	}
+	log_file = NULL;
+}
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#define SWEEP_POLICIES 3
+const char* sweep_policy_names[SWEEP_POLICIES] = {"script", "random", "ai"};
+
+// one headless game and what came out of it
+typedef struct SimJob {
+	unsigned int seed;
+	int policy;
+	int score;
+	int crash_frame; // -1 if the run lasted all its frames
+	int frames;
+	double max_speed;
+	double mean_speed;
+	double airborne; // fraction of frames in the air
+} SimJob;
+
+// the scripted pattern, random presses, or the usual trick of holding space
+// while the dune under the ball falls away and letting go on the way up
+bool sim_spacebar(int policy, const World* world, int frame, unsigned int* rng){
+	if (policy == 0) return frame % SCRIPT_PERIOD < SCRIPT_HOLD;
+	if (policy == 1){
+		*rng = *rng*1103515245 + 12345;
+		return (*rng >> 20) & 1;
+	}
+	return terrain_slope(world, world->currentX + world->ball.x) > 0;
+}
+
+// build the terrain for a seed unless it is already there, and start a run on
+// it; the sky strips env_render copies are built once, here
+void env_reset(DuneEnv* env, DuneTerrain* terrain, unsigned int seed){
+	build_layers();
+	if (!terrain->built || terrain->seed != seed){
+		build_terrain(seed, terrain->points, terrain->angles, terrain->heights);
+		terrain->seed = seed;
+		terrain->built = true;
+	}
+	reset_world(&env->world, terrain->points, terrain->angles, terrain->heights);
+	env->score = 0;
+	env->frames = 0;
+	env->flags = 0;
+	env->bonus = false;
+	env->done = false;
+	env->seed = seed;
+}
+
+// one frame of play with the spacebar held or not; returns the points it
+// scored, which are 0 once the run is done
+int env_step(DuneEnv* env, bool spacebar){
+	if (env->done) return 0;
+	World* world = &env->world;
+	// scored before the step, with the speed the frame shows, like prepare_frame
+	int score = add_score(env->score, world->ball.dx, env->bonus);
+	int reward = score - env->score;
+	env->score = score;
+	int prevY = world->ball.y;
+	env->flags = physics_step(world, spacebar);
+	env->bonus = prevY > SCORE_LINE_Y && world->ball.y < SCORE_LINE_Y;
+	env->frames++;
+	env->done = (env->flags & STEP_CRASH) || score >= 999999;
+	return reward;
+}
+
+// draw an environment as the game would show it and return the picture:
+// RESOLUTION_Y rows of RGB565 pixels starting 512 pixels apart, in a buffer
+// of its own that the next call draws over. Only the environment is read:
+// the sky is at its scroll, not the game's, and the game's buffers, layer
+// offsets and +2500 countdown are left as they were. One thread at a time,
+// since the drawing functions target pixel_buffer_start for the call.
+const short int* env_render(const DuneEnv* env){
+	int gameBuffer = pixel_buffer_start;
+	pixel_buffer_start = ENV_BUFFER;
+	int offsets[2];
+	layer_scroll(env->world.currentX, offsets);
+	for(int y = 0; y < RESOLUTION_Y; y++){
+		short int* row = PIXEL_ADDR(0, y);
+		if(y < LAYER_BOTTOM) memcpy(row, &layer_pixels[y][offsets[y >= CLOUD_BOTTOM]], RESOLUTION_X*sizeof(short int));
+		else for(int x = 0; x < RESOLUTION_X; x++) row[x] = background_rows[y];
+	}
+	Ball ball = env->world.ball;
+	Dune dune = env->world.dune;
+	Arrow arrow = {.x = BALL_X, .y = 5, .h = MIN_ARROW_HEIGHT, .h1 = MIN_ARROW_HEIGHT, .h2 = MIN_ARROW_HEIGHT, .color = WHITE};
+	draw_dune(&dune);
+	// what draw does, less the +2500 the game's renderer counts down
+	draw_line(0, SCORE_LINE_Y, RESOLUTION_X-1, SCORE_LINE_Y, WHITE);
+	draw_score(env->score);
+	if(in_y_bounds(ball.y + ball.radius)) fill_ball(&ball);
+	else{
+		update_arrow(&arrow, ball.y);
+		draw_arrow(&arrow);
+	}
+	draw_dune_slice(&dune, BALL_X-BALL_R, BALL_X+BALL_R);
+	pixel_buffer_start = gameBuffer;
+	return (const short int *) BUS(ENV_BUFFER);
+}
+
+DuneBatch* batch_create(int count){
+	DuneBatch* batch = malloc(sizeof(DuneBatch));
+	if (!batch) return NULL;
+	batch->count = count;
+	batch->envs = calloc(count, sizeof(DuneEnv));
+	batch->terrains = calloc(count, sizeof(DuneTerrain));
+	if (!batch->envs || !batch->terrains){
+		batch_free(batch);
+		return NULL;
+	}
+	return batch;
+}
+
+void batch_free(DuneBatch* batch){
+	free(batch->envs);
+	free(batch->terrains);
+	free(batch);
+}
+
+// environment i plays the terrain of seed + i
+void batch_reset(DuneBatch* batch, unsigned int seed){
+	for (int i = 0; i < batch->count; i++) env_reset(&batch->envs[i], &batch->terrains[i], seed + i);
+}
+
+// step every environment with its own action; rewards gets what each scored
+void batch_step(DuneBatch* batch, const bool* actions, int* rewards){
+	for (int i = 0; i < batch->count; i++) rewards[i] = env_step(&batch->envs[i], actions[i]);
+}
+
+// steps per second for batches played by the slope policy, each run
+// restarted on a new terrain when it ends
+void bench_env(FILE* out, long steps){
+	int sizes[] = {1, 16, 256, 1024};
+	fprintf(out, "envs,steps,ns_per_step,steps_per_s,runs_ended\n");
+	for (int s = 0; s < 4; s++){
+		int n = sizes[s];
+		DuneBatch* batch = batch_create(n);
+		bool* actions = malloc(n*sizeof(bool));
+		int* rewards = malloc(n*sizeof(int));
+		unsigned int seed = 1;
+		batch_reset(batch, seed);
+		seed += n;
+		unsigned int rng = 1;
+		long done = 0;
+		int ended = 0;
+		double start = now_ns();
+		while (done < steps){
+			for (int i = 0; i < n; i++) actions[i] = sim_spacebar(2, &batch->envs[i].world, batch->envs[i].frames, &rng);
+			batch_step(batch, actions, rewards);
+			for (int i = 0; i < n; i++){
+				if (!batch->envs[i].done) continue;
+				env_reset(&batch->envs[i], &batch->terrains[i], seed++);
+				ended++;
+			}
+			done += n;
+		}
+		double ns = now_ns() - start;
+		fprintf(out, "%d,%ld,%.1f,%.0f,%d\n", n, done, ns/done, done*1e9/ns, ended);
+		free(actions);
+		free(rewards);
+		batch_free(batch);
+	}
+}
+
+// the scripted inputs of a run played by env_step, then by the game from a
+// trace; the game takes one more frame, the press that starts the run
+bool check_env(FILE* out, unsigned int seed){
+	static DuneTerrain terrain;
+	static DuneEnv env;
+	env_reset(&env, &terrain, seed);
+	memcpy(input_trace, "DINP", 4);
+	put_u16(input_trace + 4, TRACE_VERSION);
+	put_u16(input_trace + 6, 0);
+	put_u32(input_trace + 8, seed);
+	put_u16(input_trace + TRACE_HEADER_SIZE, TRACE_SPACEBAR);
+	while (!env.done && env.frames < SWEEP_FRAMES){
+		bool spacebar = sim_spacebar(0, &env.world, env.frames, NULL);
+		env_step(&env, spacebar);
+		put_u16(input_trace + TRACE_HEADER_SIZE + 2*env.frames, spacebar ? TRACE_SPACEBAR : 0);
+	}
+	put_u32(input_trace + 12, env.frames + 1);
+	
+	input_mode = INPUT_REPLAY;
+	max_frames = 0;
+	log_file = stderr;
+	run_game();
+	log_file = NULL;
+	bool match = final_score == env.score;
+	fprintf(out, "seed %u, %d steps%s: env score %d, game score %d, %s\n", seed, env.frames,
+			env.done ? " to the crash" : "", env.score, final_score, match ? "match" : "MISMATCH");
+	return match;
+}
+
+// play one game with the real physics and scoring, without drawing anything
+void simulate_run(SimJob* job, int max_frames){
+	DuneTerrain terrain;
+	terrain.built = false;
+	DuneEnv env;
+	env_reset(&env, &terrain, job->seed);
+	World* world = &env.world;
+	
+	unsigned int rng = job->seed;
+	int airborne = 0;
+	double speed_sum = 0;
+	job->crash_frame = -1;
+	job->max_speed = 0;
+	int frame;
+	for (frame = 0; frame < max_frames && !env.done; frame++){
+		env_step(&env, sim_spacebar(job->policy, world, frame, &rng));
+		
+		double speed = sqrt(world->ball.dx*world->ball.dx + world->ball.dy*world->ball.dy);
+		speed_sum += speed;
+		if (speed > job->max_speed) job->max_speed = speed;
+		if (!(env.flags & STEP_CONTACT)) airborne++;
+		if (env.flags & STEP_CRASH) job->crash_frame = frame;
+	}
+	job->score = env.score;
+	job->frames = frame;
+	job->mean_speed = speed_sum / frame;
+	job->airborne = (double) airborne / frame;
+}
+
+// Work stealing: each worker takes jobs from the back of its own queue and,
+// once that is empty, steals from the front of the others. Jobs are whole
+// games, so a lock per queue costs nothing next to the work.
+typedef struct WorkQueue {
+	pthread_mutex_t lock;
+	int* jobs;
+	int head, tail;
+} WorkQueue;
+
+typedef struct SweepPool {
+	SimJob* jobs;
+	WorkQueue* queues;
+	int threads;
+	int max_frames;
+} SweepPool;
+
+typedef struct SweepWorker {
+	SweepPool* pool;
+	int id;
+	pthread_t thread;
+} SweepWorker;
+
+// job index from the back (own queue) or front (stealing), -1 when empty
+int take_job(WorkQueue* queue, bool steal){
+	int job = -1;
+	pthread_mutex_lock(&queue->lock);
+	if (queue->head < queue->tail)
+		job = steal ? queue->jobs[queue->head++] : queue->jobs[--queue->tail];
+	pthread_mutex_unlock(&queue->lock);
+	return job;
+}
+
+void* sweep_worker(void* arg){
+	SweepWorker* worker = arg;
+	SweepPool* pool = worker->pool;
+	while (1){
+		int job = take_job(&pool->queues[worker->id], false);
+		for (int i = 1; job < 0 && i < pool->threads; i++)
+			job = take_job(&pool->queues[(worker->id + i) % pool->threads], true);
+		// no job is ever added, so empty queues everywhere means done
+		if (job < 0) return NULL;
+		simulate_run(&pool->jobs[job], pool->max_frames);
+	}
+}
+
+// count games across every seed and input policy on a pool of threads, one
+// CSV row per game in job order and a summary on stderr
+void run_sweep(FILE* out, int count, int threads, int frames){
+	if (threads <= 0) threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (threads <= 0) threads = 1;
+	SimJob* jobs = calloc(count, sizeof(SimJob));
+	WorkQueue* queues = calloc(threads, sizeof(WorkQueue));
+	SweepWorker* workers = calloc(threads, sizeof(SweepWorker));
+	SweepPool pool = {.jobs = jobs, .queues = queues, .threads = threads, .max_frames = frames};
+	for (int t = 0; t < threads; t++){
+		pthread_mutex_init(&queues[t].lock, NULL);
+		queues[t].jobs = malloc(count * sizeof(int));
+	}
+	// deal the jobs out round robin
+	for (int i = 0; i < count; i++){
+		jobs[i].seed = i / SWEEP_POLICIES + 1;
+		jobs[i].policy = i % SWEEP_POLICIES;
+		WorkQueue* queue = &queues[i % threads];
+		queue->jobs[queue->tail++] = i;
+	}
+	
+	double start = now_ns();
+	for (int t = 0; t < threads; t++){
+		workers[t].pool = &pool;
+		workers[t].id = t;
+		pthread_create(&workers[t].thread, NULL, sweep_worker, &workers[t]);
+	}
+	for (int t = 0; t < threads; t++)
+		pthread_join(workers[t].thread, NULL);
+	double elapsed = (now_ns() - start) * 1e-9;
+	
+	fprintf(out, "seed,policy,score,crash_frame,frames,max_speed,mean_speed,airborne\n");
+	long total_frames = 0;
+	double score_sum[SWEEP_POLICIES] = {0};
+	int crashes[SWEEP_POLICIES] = {0}, runs[SWEEP_POLICIES] = {0};
+	for (int i = 0; i < count; i++){
+		SimJob* job = &jobs[i];
+		fprintf(out, "%u,%s,%d,%d,%d,%.2f,%.2f,%.3f\n", job->seed, sweep_policy_names[job->policy], job->score,
+				job->crash_frame, job->frames, job->max_speed, job->mean_speed, job->airborne);
+		total_frames += job->frames;
+		score_sum[job->policy] += job->score;
+		crashes[job->policy] += job->crash_frame >= 0;
+		runs[job->policy]++;
+	}
+	fprintf(stderr, "%d games, %ld frames on %d threads in %.2fs: %.0f games/s, %.0f frames/s\n",
+			count, total_frames, threads, elapsed, count / elapsed, total_frames / elapsed);
+	for (int p = 0; p < SWEEP_POLICIES; p++){
+		if (runs[p]) fprintf(stderr, "%s: mean score %.0f, %d of %d crashed\n",
+							 sweep_policy_names[p], score_sum[p] / runs[p], crashes[p], runs[p]);
+	}
+	
+	for (int t = 0; t < threads; t++){
+		pthread_mutex_destroy(&queues[t].lock);
+		free(queues[t].jobs);
+	}
+	free(workers);
+	free(queues);
+	free(jobs);
+}
+
+// two thread split: the simulation runs up to FRAME_QUEUE_SIZE-1 frames ahead
+// on its own thread while the calling thread clears, draws and swaps
+void* simulate_thread(void* arg){
+	Game* game = arg;
+	GameFrame* frame;
+	while (game_running()){
+		while (!(frame = queue_reserve(&frame_queue))) sched_yield();
+		prepare_frame(game, frame);
+		queue_publish(&frame_queue);
+		advance_game(game);
+		frames_run++;
+	}
+	while (!(frame = queue_reserve(&frame_queue))) sched_yield();
+	frame->mode = MODE_STOP;
+	queue_publish(&frame_queue);
+	return NULL;
+}
+
+void run_split(){
+	start_game(&game);
+	setup_devices();
+	start_renderer(&renderer, &game.world.ball);
+	
+	// the simulation thread reads the terrain, so the renderer's idle time must not build it
+	terrain_finish(&game.terrain);
+	pthread_t simulation;
+	pthread_create(&simulation, NULL, simulate_thread, &game);
+	for (;;){
+		GameFrame* frame;
+		while (!(frame = queue_front(&frame_queue))) sched_yield();
+		if (frame->mode == MODE_STOP) break;
+		render_frame(&renderer, frame);
+		queue_release(&frame_queue);
+		present_frame(&renderer);
+	}
+	queue_release(&frame_queue);
+	pthread_join(simulation, NULL);
+}
+
+// Frame capture: each presented buffer is copied into a free slot of a fixed
+// pool and handed to a writer thread, which encodes and writes it. The
+// renderer only pays for the copy, and only waits if every slot is still
+// queued, so the capture is frame accurate.
+#define CAPTURE_SLOTS 8
+#define CAPTURE_FPS 60
+typedef struct Capture {
+	FILE* file;
+	bool y4m; // YUV 4:2:0 in a Y4M stream, or else packed RGB24
+	short int slots[CAPTURE_SLOTS][RESOLUTION_Y][RESOLUTION_X];
+	unsigned char* out; // one encoded frame, owned by the writer
+	int head, count; // slots [head, head + count) wait for the writer
+	bool done; // no more frames will be queued
+	bool failed;
+	unsigned int frames; // frames written
+	unsigned int waits; // frames that found every slot queued
+	double writeNs; // time the writer spent encoding and writing
+	pthread_mutex_t lock;
+	pthread_cond_t queued, freed;
+	pthread_t writer;
+} Capture;
+Capture capture;
+
+static inline void rgb_of(short int pixel, int* r, int* g, int* b){
+	*r = ((pixel >> 11) & 0x1F) * 255/31;
+	*g = ((pixel >> 5) & 0x3F) * 255/63;
+	*b = (pixel & 0x1F) * 255/31;
+}
+
+// full range BT.601 with the chroma of each 2x2 block averaged, as in JPEG
+static int encode_y4m(unsigned char* out, short int (*pixels)[RESOLUTION_X]){
+	unsigned char* luma = out;
+	unsigned char* cb = luma + RESOLUTION_X*RESOLUTION_Y;
+	unsigned char* cr = cb + RESOLUTION_X*RESOLUTION_Y/4;
+	for(int y = 0; y < RESOLUTION_Y; y += 2){
+		for(int x = 0; x < RESOLUTION_X; x += 2){
+			int sumR = 0, sumG = 0, sumB = 0;
+			for(int k = 0; k < 4; k++){
+				int r, g, b;
+				rgb_of(pixels[y + k/2][x + k%2], &r, &g, &b);
+				luma[(y + k/2)*RESOLUTION_X + x + k%2] = (77*r + 150*g + 29*b) >> 8;
+				sumR += r;
+				sumG += g;
+				sumB += b;
+			}
+			int chroma = (y/2)*(RESOLUTION_X/2) + x/2;
+			cb[chroma] = 128 + ((-43*sumR - 85*sumG + 128*sumB) >> 10);
+			cr[chroma] = 128 + ((128*sumR - 107*sumG - 21*sumB) >> 10);
+		}
+	}
+	return RESOLUTION_X*RESOLUTION_Y*3/2;
+}
+
+static int encode_rgb(unsigned char* out, short int (*pixels)[RESOLUTION_X]){
+	for(int y = 0; y < RESOLUTION_Y; y++){
+		for(int x = 0; x < RESOLUTION_X; x++){
+			int r, g, b;
+			rgb_of(pixels[y][x], &r, &g, &b);
+			*out++ = r;
+			*out++ = g;
+			*out++ = b;
+		}
+	}
+	return RESOLUTION_X*RESOLUTION_Y*3;
+}
+
+static void* capture_writer(void* arg){
+	(void) arg;
+	pthread_mutex_lock(&capture.lock);
+	for(;;){
+		while (capture.count == 0 && !capture.done) pthread_cond_wait(&capture.queued, &capture.lock);
+		if (capture.count == 0) break;
+		int slot = capture.head;
+		pthread_mutex_unlock(&capture.lock);
+		
+		unsigned int started = trace_ns();
+		int size = capture.y4m ? encode_y4m(capture.out, capture.slots[slot]) : encode_rgb(capture.out, capture.slots[slot]);
+		if ((capture.y4m && fputs("FRAME\n", capture.file) == EOF) || fwrite(capture.out, 1, size, capture.file) != (size_t) size)
+			capture.failed = true;
+		capture.writeNs += trace_ns() - started;
+		
+		pthread_mutex_lock(&capture.lock);
+		capture.frames++;
+		capture.head = (capture.head + 1) % CAPTURE_SLOTS;
+		capture.count--;
+		pthread_cond_signal(&capture.freed);
+	}
+	pthread_mutex_unlock(&capture.lock);
+	return NULL;
+}
+
+// a .y4m path gets a Y4M stream, anything else raw RGB24 frames
+bool capture_output(const char* path){
+	size_t length = strlen(path);
+	capture.y4m = length >= 4 && !strcmp(path + length - 4, ".y4m");
+	capture.file = fopen(path, "wb");
+	if (!capture.file) return false;
+	if (capture.y4m && fprintf(capture.file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", RESOLUTION_X, RESOLUTION_Y, CAPTURE_FPS) < 0)
+		return false;
+	capture.out = malloc(RESOLUTION_X*RESOLUTION_Y*3);
+	if (!capture.out) return false;
+	pthread_mutex_init(&capture.lock, NULL);
+	pthread_cond_init(&capture.queued, NULL);
+	pthread_cond_init(&capture.freed, NULL);
+	return pthread_create(&capture.writer, NULL, capture_writer, NULL) == 0;
+}
+
+// called by the renderer with the buffer being swapped to the front
+void capture_frame(int buffer){
+	if (!capture.out) return;
+	pthread_mutex_lock(&capture.lock);
+	if (capture.count == CAPTURE_SLOTS) capture.waits++;
+	while (capture.count == CAPTURE_SLOTS) pthread_cond_wait(&capture.freed, &capture.lock);
+	int slot = (capture.head + capture.count) % CAPTURE_SLOTS;
+	pthread_mutex_unlock(&capture.lock);
+	
+	// the slot is not queued yet, so the writer does not look at it
+	for (int y = 0; y < RESOLUTION_Y; y++)
+		memcpy(capture.slots[slot][y], BUS(buffer + (y << 10)), sizeof(capture.slots[slot][y]));
+	
+	pthread_mutex_lock(&capture.lock);
+	capture.count++;
+	pthread_cond_signal(&capture.queued);
+	pthread_mutex_unlock(&capture.lock);
+}
+
+// write out the queued frames and close the stream; true if nothing was captured
+bool capture_finish(){
+	if (!capture.out) return true;
+	pthread_mutex_lock(&capture.lock);
+	capture.done = true;
+	pthread_cond_signal(&capture.queued);
+	pthread_mutex_unlock(&capture.lock);
+	pthread_join(capture.writer, NULL);
+	free(capture.out);
+	capture.out = NULL;
+	if (capture.frames > 0)
+		printf("capture: %u frames, %.2f ms each to write, %u waited for a free slot\n",
+			   capture.frames, capture.writeNs / 1e6 / capture.frames, capture.waits);
+	return fclose(capture.file) == 0 && !capture.failed;
+}
+
+// workers for band-parallel passes; the calling thread draws band 0
+typedef struct RasterPool {
+	pthread_t threads[MAX_RASTER_THREADS];
+	pthread_barrier_t start, done;
+	void (*pass)(void* arg);
+	void* arg;
+	int bands;
+	bool running;
+} RasterPool;
+RasterPool raster_pool;
+
+static void run_band(int band, int bands, void (*pass)(void* arg), void* arg){
+	band_top = RESOLUTION_Y*band / bands;
+	band_bottom = RESOLUTION_Y*(band+1) / bands;
+	in_band_pass = true;
+	pass(arg);
+	in_band_pass = false;
+	band_top = 0;
+	band_bottom = RESOLUTION_Y;
+}
+
+void* raster_worker(void* arg){
+	int band = (int) (intptr_t) arg;
+	for (;;){
+		pthread_barrier_wait(&raster_pool.start);
+		run_band(band, raster_pool.bands, raster_pool.pass, raster_pool.arg);
+		pthread_barrier_wait(&raster_pool.done);
+	}
+	return NULL;
+}
+
+void raster_dispatch(void (*pass)(void* arg), void* arg){
+	RasterPool* pool = &raster_pool;
+	if (!pool->running){
+		pool->bands = min(raster_threads, MAX_RASTER_THREADS);
+		pthread_barrier_init(&pool->start, NULL, pool->bands);
+		pthread_barrier_init(&pool->done, NULL, pool->bands);
+		for (int t = 1; t < pool->bands; t++)
+			pthread_create(&pool->threads[t], NULL, raster_worker, (void *) (intptr_t) t);
+		pool->running = true;
+	}
+	pool->pass = pass;
+	pool->arg = arg;
+	pthread_barrier_wait(&pool->start);
+	run_band(0, pool->bands, pass, arg);
+	pthread_barrier_wait(&pool->done);
+}
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+static unsigned char* reader_chunk(TelemetryReader* reader, unsigned int chunk){
+	return reader->base + TELEMETRY_HEADER_SIZE + ((reader->oldest + chunk) % reader->slots)*TELEMETRY_CHUNK;
+}
+
+// start reading at the first frame of a chunk
+static void reader_enter(TelemetryReader* reader, unsigned int chunk){
+	reader->chunk = chunk;
+	reader->offset = TELEMETRY_CHUNK_HEADER;
+	reader->left = 0;
+	memset(&reader->delta, 0, sizeof(reader->delta));
+	if (chunk >= reader->chunks) return;
+	reader->next = get_u32(reader_chunk(reader, chunk));
+	reader->left = get_u16(reader_chunk(reader, chunk) + 4);
+}
+
+// map a telemetry file read only; the pages are only touched as frames are
+// read, so opening is fast however long the file is
+bool telemetry_map(TelemetryReader* reader, const char* path){
+	memset(reader, 0, sizeof(*reader));
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) return false;
+	struct stat st;
+	void* base = MAP_FAILED;
+	if (fstat(fd, &st) == 0 && st.st_size >= TELEMETRY_HEADER_SIZE)
+		base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED) return false;
+	reader->base = base;
+	reader->size = st.st_size;
+	reader->slots = (reader->size - TELEMETRY_HEADER_SIZE) / TELEMETRY_CHUNK;
+	reader->oldest = get_u32(reader->base + 12);
+	if (memcmp(reader->base, "DTEL", 4) || get_u16(reader->base + 4) != TELEMETRY_VERSION ||
+		get_u16(reader->base + 6) != TELEMETRY_CHUNK || (reader->slots && reader->oldest >= reader->slots)){
+		telemetry_unmap(reader);
+		return false;
+	}
+	// a dump of a ring that has not wrapped ends in empty chunks
+	while (reader->chunks < reader->slots && get_u16(reader_chunk(reader, reader->chunks) + 4)) reader->chunks++;
+	reader_enter(reader, 0);
+	return true;
+}
+
+// make the next frame read the first one numbered frame or later; the chunk
+// is found from the chunk headers alone, then only that chunk is decoded
+bool telemetry_seek(TelemetryReader* reader, unsigned int frame){
+	unsigned int lo = 0, hi = reader->chunks; // find the first chunk starting after frame
+	while (lo < hi){
+		unsigned int mid = (lo + hi) / 2;
+		if (get_u32(reader_chunk(reader, mid)) <= frame) lo = mid + 1;
+		else hi = mid;
+	}
+	reader_enter(reader, lo ? lo - 1 : 0);
+	TelemetryFrame skipped;
+	while (reader->left && reader->next < frame && telemetry_next(reader, &skipped));
+	return reader->left > 0 || reader->chunk + 1 < reader->chunks;
+}
+
+// decode the next frame, false at the end of the file
+bool telemetry_next(TelemetryReader* reader, TelemetryFrame* frame){
+	while (reader->left == 0){
+		if (reader->chunk + 1 >= reader->chunks) return false;
+		reader_enter(reader, reader->chunk + 1);
+	}
+	// a record never starts where the longest one might not fit
+	if (reader->offset + TELEMETRY_MAX_RECORD > TELEMETRY_CHUNK) return false;
+	reader->offset += telemetry_decode(reader_chunk(reader, reader->chunk) + reader->offset, frame, &reader->delta);
+	frame->frame = reader->next++;
+	reader->left--;
+	return true;
+}
+
+void telemetry_unmap(TelemetryReader* reader){
+	if (reader->base) munmap(reader->base, reader->size);
+	reader->base = NULL;
+}
+
+// print count frames from frame first on as CSV, or all of them for count 0
+bool telemetry_dump(FILE* out, const char* path, unsigned int first, unsigned int count){
+	TelemetryReader reader;
+	if (!telemetry_map(&reader, path)) return false;
+	fprintf(out, "frame,mode,contact,crash,x,y,dx,dy,scroll,score,switches,spacebar,step_us,render_us,swap_us\n");
+	TelemetryFrame frame;
+	telemetry_seek(&reader, first);
+	for (unsigned int n = 0; (count == 0 || n < count) && telemetry_next(&reader, &frame); n++){
+		int* value = frame.value;
+		fprintf(out, "%u,%d,%d,%d,%d,%d,%.3f,%.3f,%.3f,%d,%d,%d,%d,%d,%d\n", frame.frame, frame.mode,
+				(frame.flags & STEP_CONTACT) != 0, (frame.flags & STEP_CRASH) != 0,
+				value[TELEMETRY_X], value[TELEMETRY_Y], (double) value[TELEMETRY_DX]/TELEMETRY_FIXED,
+				(double) value[TELEMETRY_DY]/TELEMETRY_FIXED, (double) value[TELEMETRY_SCROLL]/TELEMETRY_FIXED,
+				value[TELEMETRY_SCORE], value[TELEMETRY_INPUT] & ~TRACE_SPACEBAR, (value[TELEMETRY_INPUT] & TRACE_SPACEBAR) != 0,
+				value[TELEMETRY_STEP], value[TELEMETRY_RENDER], value[TELEMETRY_SWAP]);
+	}
+	telemetry_unmap(&reader);
+	return true;
+}
+
+// the formulas behind the generated tables; --gen-tables prints the block
+// between the GENERATED TABLES markers
+#define GEN_TABLE(out, decl, count, format, expr) do { \
+	fprintf(out, "static const %s = {", decl); \
+	for (int i = 0; i < (count); i++) fprintf(out, "%s" format ",", (i % 8) ? " " : "\n\t", expr); \
+	fprintf(out, "\n};\n"); \
+} while (0)
+
+static int title_dune_point(int x){
+	int amplitude = (x <= DUNE_PERIOD) ? 20 : 10;
+	return (int) amplitude*sin(DUNE_FREQUENCY*(x)) + 200;
+}
+
+static double title_dune_angle(int x){
+	int amplitude = (x <= DUNE_PERIOD) ? 20 : 10;
+	return atan(amplitude*DUNE_FREQUENCY*cos(DUNE_FREQUENCY*(x)));
+}
+
+void gen_tables(FILE* out){
+	fprintf(out, "// BEGIN GENERATED TABLES\n");
+	fprintf(out, "// BACKGROUND + GRADIENT*y / RESOLUTION_Y\n");
+	GEN_TABLE(out, "short int background_rows[RESOLUTION_Y]", RESOLUTION_Y, "0x%04X",
+			  (unsigned short) (BACKGROUND + GRADIENT*i / RESOLUTION_Y));
+	fprintf(out, "// sin(DUNE_FREQUENCY*x) and cos(DUNE_FREQUENCY*x) over one dune\n");
+	GEN_TABLE(out, "double dune_sine[DUNE_PERIOD]", DUNE_PERIOD, "%.17g", sin(DUNE_FREQUENCY*(i)));
+	GEN_TABLE(out, "double dune_cosine[DUNE_PERIOD]", DUNE_PERIOD, "%.17g", cos(DUNE_FREQUENCY*(i)));
+	fprintf(out, "// title screen dune, amplitude 20 for the first dune and 10 after\n");
+	GEN_TABLE(out, "int title_dune_points[RESOLUTION_X]", RESOLUTION_X, "%d", title_dune_point(i));
+	GEN_TABLE(out, "double title_dune_angles[RESOLUTION_X]", RESOLUTION_X, "%.17g", title_dune_angle(i));
+	fprintf(out, "// half widths of the D in the logo, sqrt(42*42 - y*y) and sqrt(28*28 - y*y)\n");
+	GEN_TABLE(out, "unsigned char logo_outer_span[43]", 43, "%d", (int) sqrt(1764 - i*i));
+	GEN_TABLE(out, "unsigned char logo_inner_span[29]", 29, "%d", (int) sqrt(784 - i*i));
+	fprintf(out, "// END GENERATED TABLES\n");
+}
+#endif